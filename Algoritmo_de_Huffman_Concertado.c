@@ -2,104 +2,4028 @@
 #include <stdlib.h>
 #include <string.h>
 #include <locale.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "huff.h"
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#define CRC32C_HARDWARE
+#endif
 
 #define BYTE unsigned char
 
-typedef struct No {
+// Tamanho padrão dos blocos de leitura/escrita (1 MiB), alterável com -b;
+// o escritor de bits precisa de pelo menos 8 bytes livres de uma vez
+#define TAMANHO_BLOCO_IO (1 << 20)
+#define TAMANHO_MINIMO_BLOCO_IO 16
+
+size_t tamanho_bloco_io = TAMANHO_BLOCO_IO;
+
+// Limite de bits por código (0 = sem limite), alterável com -l
+int max_bits_codigo = 0;
+
+// Modo em blocos independentes: tamanho de cada bloco (0 = bloco único),
+// alterável com -B, e número de threads, alterável com -t
+#define TAMANHO_BLOCO_CONTEINER (4 << 20)
+
+size_t tamanho_bloco_conteiner = 0;
+int num_threads = 1;
+
+// Lê a entrada por mmap quando possível; -M força a leitura em blocos
+int usar_mmap = 1;
+
+// Threads da contagem de frequências do modo de bloco único, alterável com -T
+int threads_contagem = 1;
+
+// Modo de ordem 1 (uma tabela de códigos por byte anterior), ligado com -o
+int usar_contexto = 0;
+
+// Huffman adaptativo, em uma passada e sem cabeçalho, ligado com -a
+int usar_adaptativo = 0;
+
+// Pré-passada RLE nos modos de bloco único e em blocos, ligada com -r
+int usar_rle = 0;
+
+// Quatro fluxos de bits intercalados por bloco, ligados com -i
+int usar_intercalado = 0;
+
+// Nós da árvore ficam numa arena de tamanho fixo (256 folhas e 255 nós
+// internos no máximo), com os filhos guardados como índices na arena; a
+// árvore inteira é descartada de uma vez, sem um free por nó
+#define MAX_NOS 511
+#define SEM_NO (-1)
+
+typedef struct {
     BYTE caractere;
-    int frequencia;
-    struct No *esquerda, *direita;
+    uint64_t frequencia;
+    int16_t esquerda, direita;
 } No;
 
-typedef struct {
-    BYTE byte;
-    int bits;
-    BYTE codigo[256];
-} Codigo;
+typedef struct {
+    No nos[MAX_NOS];
+    int usados;
+} Arena;
+
+// Código empacotado: os "bits" menos significativos de "codigo", do mais
+// significativo (primeiro bit emitido) para o menos significativo
+typedef struct {
+    uint64_t codigo;
+    int bits;
+} Codigo;
+
+typedef struct {
+    BYTE byte;
+    int frequencia;
+} Frequencia;
+
+typedef struct {
+    BYTE byte;
+    int frequencia;
+} Item;
+
+// CRC32C (Castagnoli) dos dados originais, gravado no cabeçalho estendido.
+// Com SSE4.2 usa a instrução crc32 (8 bytes por instrução); sem ela, tabelas
+// "slicing-by-8", que consomem 8 bytes por iteração com 8 consultas
+// independentes. A escolha é feita uma vez, na primeira chamada
+
+#define POLINOMIO_CRC32C 0x82F63B78u
+
+uint32_t tabela_crc32c[8][256];
+uint32_t (*crc32c_bloco)(uint32_t crc, const BYTE *dados, size_t n);
+pthread_once_t crc32c_pronto = PTHREAD_ONCE_INIT;
+
+// Recebem e devolvem o CRC invertido, como o registrador da instrução crc32
+uint32_t crc32c_fatias(uint32_t crc, const BYTE *dados, size_t n)
+{
+    for (; n >= 8; n -= 8, dados += 8)
+    {
+        uint32_t um = crc ^ ((uint32_t) dados[0] | (uint32_t) dados[1] << 8 |
+                             (uint32_t) dados[2] << 16 | (uint32_t) dados[3] << 24);
+        crc = tabela_crc32c[7][um & 0xFF] ^ tabela_crc32c[6][(um >> 8) & 0xFF] ^
+              tabela_crc32c[5][(um >> 16) & 0xFF] ^ tabela_crc32c[4][um >> 24] ^
+              tabela_crc32c[3][dados[4]] ^ tabela_crc32c[2][dados[5]] ^
+              tabela_crc32c[1][dados[6]] ^ tabela_crc32c[0][dados[7]];
+    }
+    for (; n; n--, dados++)
+        crc = (crc >> 8) ^ tabela_crc32c[0][(crc ^ *dados) & 0xFF];
+    return crc;
+}
+
+#ifdef CRC32C_HARDWARE
+__attribute__((target("sse4.2")))
+uint32_t crc32c_sse42(uint32_t crc, const BYTE *dados, size_t n)
+{
+    uint64_t c = crc;
+    for (; n >= 8; n -= 8, dados += 8)
+    {
+        uint64_t v;
+        memcpy(&v, dados, sizeof(v));
+        c = _mm_crc32_u64(c, v);
+    }
+    crc = (uint32_t) c;
+    for (; n; n--, dados++)
+        crc = _mm_crc32_u8(crc, *dados);
+    return crc;
+}
+#endif
+
+void montar_tabela_crc32c()
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+        for (int k = 0; k < 8; k++)
+            crc = (crc >> 1) ^ (crc & 1 ? POLINOMIO_CRC32C : 0);
+        tabela_crc32c[0][i] = crc;
+    }
+    for (int t = 1; t < 8; t++)
+        for (int i = 0; i < 256; i++)
+            tabela_crc32c[t][i] = (tabela_crc32c[t - 1][i] >> 8) ^ tabela_crc32c[0][tabela_crc32c[t - 1][i] & 0xFF];
+
+    crc32c_bloco = crc32c_fatias;
+#ifdef CRC32C_HARDWARE
+    if (__builtin_cpu_supports("sse4.2"))
+        crc32c_bloco = crc32c_sse42;
+#endif
+}
+
+// Continua o CRC "crc" (0 no início) com mais "n" bytes
+uint32_t atualizar_crc32c(uint32_t crc, const BYTE *dados, size_t n)
+{
+    pthread_once(&crc32c_pronto, montar_tabela_crc32c);
+    return ~crc32c_bloco(~crc, dados, n);
+}
+
+// Leitura e escrita em blocos
+
+typedef struct {
+    FILE *arquivo;
+    BYTE *dados;
+    size_t tamanho;
+    size_t pos;
+    size_t capacidade;
+} Leitor;
+
+// Com "conferir_crc", o escritor em arquivo acumula em "crc" o CRC32C de
+// tudo o que descarrega, enquanto os dados ainda estão no cache. Com
+// "fixo", o escritor em memória usa um buffer de terceiros e não cresce
+typedef struct {
+    FILE *arquivo;
+    BYTE *dados;
+    size_t pos;
+    size_t capacidade;
+    uint64_t descarregados;
+    int erro;
+    int conferir_crc;
+    uint32_t crc;
+    int fixo;
+} Escritor;
+
+int abrir_leitor(Leitor *leitor, FILE *arquivo)
+{
+    leitor->arquivo = arquivo;
+    leitor->capacidade = tamanho_bloco_io;
+    leitor->tamanho = 0;
+    leitor->pos = 0;
+    leitor->dados = (BYTE *) malloc(leitor->capacidade);
+    return leitor->dados != NULL;
+}
+
+// Leitor sobre dados já em memória (não copia nem libera "dados")
+void abrir_leitor_memoria(Leitor *leitor, const BYTE *dados, size_t tamanho)
+{
+    leitor->arquivo = NULL;
+    leitor->dados = (BYTE *) dados;
+    leitor->capacidade = tamanho;
+    leitor->tamanho = 0;
+    leitor->pos = 0;
+}
+
+// Descarta o bloco atual e lê o próximo; retorna quantos bytes vieram.
+// Em memória, todos os dados vêm na primeira chamada
+size_t recarregar_leitor(Leitor *leitor)
+{
+    if (leitor->arquivo)
+        leitor->tamanho = fread(leitor->dados, sizeof(BYTE), leitor->capacidade, leitor->arquivo);
+    else
+    {
+        leitor->tamanho = leitor->capacidade;
+        leitor->capacidade = 0;
+    }
+    leitor->pos = 0;
+    return leitor->tamanho;
+}
+
+void fechar_leitor(Leitor *leitor)
+{
+    if (leitor->arquivo)
+        free(leitor->dados);
+    leitor->dados = NULL;
+}
+
+int abrir_escritor(Escritor *escritor, FILE *arquivo)
+{
+    escritor->arquivo = arquivo;
+    escritor->capacidade = tamanho_bloco_io;
+    escritor->pos = 0;
+    escritor->descarregados = 0;
+    escritor->erro = 0;
+    escritor->conferir_crc = 0;
+    escritor->crc = 0;
+    escritor->fixo = 0;
+    escritor->dados = (BYTE *) malloc(escritor->capacidade);
+    return escritor->dados != NULL;
+}
+
+// Escritor que acumula tudo em memória, crescendo conforme precisa
+int abrir_escritor_memoria(Escritor *escritor, size_t capacidade)
+{
+    escritor->arquivo = NULL;
+    escritor->capacidade = capacidade ? capacidade : 64;
+    escritor->pos = 0;
+    escritor->descarregados = 0;
+    escritor->erro = 0;
+    escritor->conferir_crc = 0;
+    escritor->crc = 0;
+    escritor->fixo = 0;
+    escritor->dados = (BYTE *) malloc(escritor->capacidade);
+    return escritor->dados != NULL;
+}
+
+// Escritor sobre um buffer que pertence a quem chama (não o libera); ao
+// encher, marca erro e volta ao início em vez de crescer. "capacidade"
+// precisa ser de pelo menos 8 bytes, por causa do escritor de bits
+void abrir_escritor_fixo(Escritor *escritor, BYTE *dados, size_t capacidade)
+{
+    escritor->arquivo = NULL;
+    escritor->dados = dados;
+    escritor->capacidade = capacidade;
+    escritor->pos = 0;
+    escritor->descarregados = 0;
+    escritor->erro = 0;
+    escritor->conferir_crc = 0;
+    escritor->crc = 0;
+    escritor->fixo = 1;
+}
+
+void descarregar_escritor(Escritor *escritor)
+{
+    if (escritor->fixo)
+        escritor->erro = 1;
+    else if (escritor->arquivo == NULL)
+    {
+        BYTE *maior = (BYTE *) realloc(escritor->dados, escritor->capacidade * 2);
+        if (maior)
+        {
+            escritor->dados = maior;
+            escritor->capacidade *= 2;
+            return;
+        }
+        escritor->erro = 1;
+    }
+    else if (escritor->pos)
+    {
+        if (escritor->conferir_crc)
+            escritor->crc = atualizar_crc32c(escritor->crc, escritor->dados, escritor->pos);
+        if (fwrite(escritor->dados, sizeof(BYTE), escritor->pos, escritor->arquivo) != escritor->pos)
+            escritor->erro = 1;
+        escritor->descarregados += escritor->pos;
+    }
+    escritor->pos = 0;
+}
+
+uint64_t bytes_escritos(Escritor *escritor)
+{
+    return escritor->descarregados + escritor->pos;
+}
+
+void escrever_byte(Escritor *escritor, BYTE c)
+{
+    if (escritor->pos == escritor->capacidade)
+        descarregar_escritor(escritor);
+    escritor->dados[escritor->pos++] = c;
+}
+
+void escrever_bytes(Escritor *escritor, const BYTE *dados, size_t n)
+{
+    while (n)
+    {
+        if (escritor->pos == escritor->capacidade)
+            descarregar_escritor(escritor);
+
+        size_t livre = escritor->capacidade - escritor->pos;
+        size_t parte = n < livre ? n : livre;
+        memcpy(escritor->dados + escritor->pos, dados, parte);
+        escritor->pos += parte;
+        dados += parte;
+        n -= parte;
+    }
+}
+
+// Para os formatos sem o tamanho original gravado: descarrega o que falta
+// e compara o CRC32C acumulado (com "conferir_crc") com o do cabeçalho
+int crc_confere(Escritor *escritor, uint32_t esperado)
+{
+    descarregar_escritor(escritor);
+    return escritor->crc == esperado;
+}
+
+void fechar_escritor(Escritor *escritor)
+{
+    if (escritor->arquivo)
+        descarregar_escritor(escritor);
+    free(escritor->dados);
+    escritor->dados = NULL;
+}
+
+// Entrada mapeada em memória: evita a cópia do fread e a segunda leitura
+// depois do rewind. Pipes e arquivos vazios não são mapeados, e quem chama
+// volta para o Leitor em blocos
+
+typedef struct {
+    BYTE *dados;
+    size_t tamanho;
+} Mapeamento;
+
+int mapear_arquivo(FILE *arquivo, Mapeamento *mapa)
+{
+    struct stat info;
+    mapa->dados = NULL;
+    mapa->tamanho = 0;
+    if (!usar_mmap || fstat(fileno(arquivo), &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0)
+        return 0;
+
+    void *dados = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fileno(arquivo), 0);
+    if (dados == MAP_FAILED)
+        return 0;
+    madvise(dados, (size_t) info.st_size, MADV_SEQUENTIAL);
+
+    mapa->dados = (BYTE *) dados;
+    mapa->tamanho = (size_t) info.st_size;
+    return 1;
+}
+
+void desmapear_arquivo(Mapeamento *mapa)
+{
+    if (mapa->dados)
+        munmap(mapa->dados, mapa->tamanho);
+    mapa->dados = NULL;
+    mapa->tamanho = 0;
+}
+
+// Leitor sobre o arquivo mapeado ou, não sendo possível, em blocos
+int abrir_entrada(Leitor *leitor, FILE *arquivo, Mapeamento *mapa)
+{
+    if (mapear_arquivo(arquivo, mapa))
+    {
+        abrir_leitor_memoria(leitor, mapa->dados, mapa->tamanho);
+        return 1;
+    }
+    return abrir_leitor(leitor, arquivo);
+}
+
+// Volta ao início da entrada para mais uma passada
+void reiniciar_entrada(Leitor *leitor, Mapeamento *mapa)
+{
+    if (mapa->dados)
+        abrir_leitor_memoria(leitor, mapa->dados, mapa->tamanho);
+    else
+        rewind(leitor->arquivo);
+}
+
+void fechar_entrada(Leitor *leitor, Mapeamento *mapa)
+{
+    fechar_leitor(leitor);
+    desmapear_arquivo(mapa);
+}
+
+// Escrita de bits: os códigos são acumulados em 64 bits e descarregados
+// de 8 em 8 bytes
+
+typedef struct {
+    Escritor *saida;
+    uint64_t acumulador;
+    int bits;
+} EscritorBits;
+
+void iniciar_escritor_bits(EscritorBits *eb, Escritor *saida)
+{
+    eb->saida = saida;
+    eb->acumulador = 0;
+    eb->bits = 0;
+}
+
+void descarregar_acumulador(EscritorBits *eb)
+{
+    Escritor *escritor = eb->saida;
+    if (escritor->capacidade - escritor->pos < 8)
+        descarregar_escritor(escritor);
+
+    BYTE *p = escritor->dados + escritor->pos;
+    for (int i = 0; i < 8; i++)
+        p[i] = (BYTE) (eb->acumulador >> (56 - 8 * i));
+    escritor->pos += 8;
+}
+
+// Escreve os "n" bits menos significativos de "codigo" (1 <= n <= 64);
+// inline, como decodificar_simbolo, por ser chamada a cada símbolo
+static inline void escrever_bits(EscritorBits *eb, uint64_t codigo, int n)
+{
+    if (eb->bits + n < 64)
+    {
+        eb->acumulador |= codigo << (64 - eb->bits - n);
+        eb->bits += n;
+        return;
+    }
+
+    int resto = eb->bits + n - 64;
+    eb->acumulador |= codigo >> resto;
+    descarregar_acumulador(eb);
+    eb->acumulador = resto ? codigo << (64 - resto) : 0;
+    eb->bits = resto;
+}
+
+// Escreve os bits pendentes e retorna quantos bits de lixo sobraram no último byte
+int finalizar_escritor_bits(EscritorBits *eb)
+{
+    int bytes = (eb->bits + 7) / 8;
+    for (int i = 0; i < bytes; i++)
+        escrever_byte(eb->saida, (BYTE) (eb->acumulador >> (56 - 8 * i)));
+
+    int lixo = (8 - eb->bits % 8) % 8;
+    eb->acumulador = 0;
+    eb->bits = 0;
+    return lixo;
+}
+
+// Leitura de bits: mantém até 64 bits à frente, alinhados à esquerda
+
+typedef struct {
+    Leitor *entrada;
+    uint64_t acumulador;
+    int bits;
+    uint64_t restantes;
+} LeitorBits;
+
+// "total_bits" é o tamanho do payload em bits, já descontado o lixo
+void iniciar_leitor_bits(LeitorBits *lb, Leitor *entrada, uint64_t total_bits)
+{
+    lb->entrada = entrada;
+    lb->acumulador = 0;
+    lb->bits = 0;
+    lb->restantes = total_bits;
+}
+
+// Fim dos dados ou do buffer: completa o acumulador byte a byte
+void recarregar_bits_lento(LeitorBits *lb)
+{
+    Leitor *leitor = lb->entrada;
+
+    while (lb->bits <= 56 && lb->restantes)
+    {
+        if (leitor->pos == leitor->tamanho && !recarregar_leitor(leitor))
+        {
+            lb->restantes = 0;
+            break;
+        }
+
+        int validos = lb->restantes < 8 ? (int) lb->restantes : 8;
+        uint64_t byte = leitor->dados[leitor->pos++] >> (8 - validos);
+        lb->acumulador |= byte << (64 - lb->bits - validos);
+        lb->bits += validos;
+        lb->restantes -= validos;
+    }
+}
+
+// Inline: chamada a cada poucos símbolos, e fora de linha o laço de
+// decodificação perdia cerca de um quinto do tempo só na chamada
+static inline void recarregar_bits(LeitorBits *lb)
+{
+    Leitor *leitor = lb->entrada;
+
+    // Caminho rápido: com 8 bytes à mão, completa o acumulador de uma vez
+    if (leitor->tamanho - leitor->pos >= 8 && lb->restantes >= 64)
+    {
+        const BYTE *p = leitor->dados + leitor->pos;
+        uint64_t v = (uint64_t) p[0] << 56 | (uint64_t) p[1] << 48 | (uint64_t) p[2] << 40 |
+                     (uint64_t) p[3] << 32 | (uint64_t) p[4] << 24 | (uint64_t) p[5] << 16 |
+                     (uint64_t) p[6] << 8 | (uint64_t) p[7];
+        int bytes = (64 - lb->bits) / 8;
+        int novos = 8 * bytes;
+        v >>= lb->bits;
+        if (lb->bits + novos < 64)
+            v &= ~(~(uint64_t) 0 >> (lb->bits + novos));
+        lb->acumulador |= v;
+        leitor->pos += bytes;
+        lb->bits += novos;
+        lb->restantes -= novos;
+        return;
+    }
+
+    recarregar_bits_lento(lb);
+}
+
+void consumir_bits(LeitorBits *lb, int n)
+{
+    lb->acumulador = n < 64 ? lb->acumulador << n : 0;
+    lb->bits -= n;
+}
+
+// Funções da árvore de Huffman
+
+// Esvazia a arena, descartando a árvore anterior
+void iniciar_arena(Arena *arena)
+{
+    arena->usados = 0;
+}
+
+// Retorna o índice do novo nó, ou SEM_NO com a arena cheia
+int criar_no(Arena *arena, BYTE caractere, uint64_t frequencia, int esquerda, int direita)
+{
+    if (arena->usados == MAX_NOS)
+        return SEM_NO;
+
+    No *novo = &arena->nos[arena->usados];
+    novo->caractere = caractere;
+    novo->frequencia = frequencia;
+    novo->esquerda = (int16_t) esquerda;
+    novo->direita = (int16_t) direita;
+    return arena->usados++;
+}
+
+int eh_folha(const No *no)
+{
+    return (no->esquerda == SEM_NO && no->direita == SEM_NO);
+}
+
+// Contagem com histogramas intercalados: bytes vizinhos vão para tabelas
+// diferentes, então uma sequência do mesmo byte não espera o incremento
+// anterior chegar à memória. Lê 8 bytes por vez
+#define HISTOGRAMAS 4
+
+void contar_8_bytes(uint32_t parciais[HISTOGRAMAS][256], uint64_t v)
+{
+    parciais[0][v & 0xFF]++;
+    parciais[1][(v >> 8) & 0xFF]++;
+    parciais[2][(v >> 16) & 0xFF]++;
+    parciais[3][(v >> 24) & 0xFF]++;
+    parciais[0][(v >> 32) & 0xFF]++;
+    parciais[1][(v >> 40) & 0xFF]++;
+    parciais[2][(v >> 48) & 0xFF]++;
+    parciais[3][v >> 56]++;
+}
+
+void contar_frequencias_bloco(const BYTE *dados, size_t n, uint64_t *frequencias)
+{
+    uint32_t parciais[HISTOGRAMAS][256];
+
+    while (n)
+    {
+        // Partes de até 1 GiB para os contadores de 32 bits não estourarem
+        size_t parte = n < ((size_t) 1 << 30) ? n : ((size_t) 1 << 30);
+        size_t i = 0;
+        memset(parciais, 0, sizeof(parciais));
+
+        for (; i + 8 <= parte; i += 8)
+        {
+            uint64_t v;
+            memcpy(&v, dados + i, sizeof(v));
+            contar_8_bytes(parciais, v);
+        }
+        for (; i < parte; i++)
+            parciais[0][dados[i]]++;
+
+        for (int c = 0; c < 256; c++)
+            frequencias[c] += (uint64_t) parciais[0][c] + parciais[1][c] + parciais[2][c] + parciais[3][c];
+
+        dados += parte;
+        n -= parte;
+    }
+}
+
+// Contagem paralela: cada thread conta uma faixa da entrada numa tabela
+// própria e as tabelas são somadas no fim, com o mesmo resultado da contagem
+// serial. Faixas em memória são contadas direto; as de arquivo, com pread
+
+#define MINIMO_POR_THREAD_CONTAGEM (1 << 20)
+
+typedef struct {
+    const BYTE *dados;
+    int descritor;
+    uint64_t inicio;
+    uint64_t tamanho;
+    uint64_t frequencias[256];
+    int erro;
+} FaixaContagem;
+
+void *trabalhador_contagem(void *arg)
+{
+    FaixaContagem *faixa = (FaixaContagem *) arg;
+    if (faixa->dados)
+    {
+        contar_frequencias_bloco(faixa->dados + faixa->inicio, (size_t) faixa->tamanho, faixa->frequencias);
+        return NULL;
+    }
+
+    BYTE *buffer = (BYTE *) malloc(tamanho_bloco_io);
+    if (!buffer)
+    {
+        faixa->erro = 1;
+        return NULL;
+    }
+    uint64_t lidos = 0;
+    while (lidos < faixa->tamanho)
+    {
+        uint64_t falta = faixa->tamanho - lidos;
+        size_t parte = falta < tamanho_bloco_io ? (size_t) falta : tamanho_bloco_io;
+        ssize_t n = pread(faixa->descritor, buffer, parte, (off_t) (faixa->inicio + lidos));
+        if (n <= 0)
+        {
+            faixa->erro = 1;
+            break;
+        }
+        contar_frequencias_bloco(buffer, (size_t) n, faixa->frequencias);
+        lidos += (uint64_t) n;
+    }
+    free(buffer);
+    return NULL;
+}
+
+// Conta "tamanho" bytes a partir de "inicio" em "dados" ou, se "dados" for
+// NULL, no descritor. Retorna 0 quando não vale ou não dá para dividir, e
+// nesse caso "frequencias" não é alterado
+int contar_frequencias_paralelo(const BYTE *dados, int descritor, uint64_t inicio, uint64_t tamanho,
+                                uint64_t *frequencias)
+{
+    int n = threads_contagem;
+    if (tamanho / MINIMO_POR_THREAD_CONTAGEM < (uint64_t) n)
+        n = (int) (tamanho / MINIMO_POR_THREAD_CONTAGEM);
+    if (n < 2)
+        return 0;
+
+    FaixaContagem *faixas = (FaixaContagem *) calloc(n, sizeof(FaixaContagem));
+    pthread_t *threads = (pthread_t *) malloc(n * sizeof(pthread_t));
+    if (!faixas || !threads)
+    {
+        free(faixas);
+        free(threads);
+        return 0;
+    }
+
+    uint64_t fatia = tamanho / n;
+    for (int i = 0; i < n; i++)
+    {
+        faixas[i].dados = dados;
+        faixas[i].descritor = descritor;
+        faixas[i].inicio = inicio + i * fatia;
+        faixas[i].tamanho = i == n - 1 ? tamanho - i * fatia : fatia;
+    }
+
+    // Faixas sem thread são contadas aqui mesmo
+    int criadas = 0;
+    while (criadas < n && pthread_create(&threads[criadas], NULL, trabalhador_contagem, &faixas[criadas]) == 0)
+        criadas++;
+    for (int i = criadas; i < n; i++)
+        trabalhador_contagem(&faixas[i]);
+    for (int i = 0; i < criadas; i++)
+        pthread_join(threads[i], NULL);
+
+    int ok = 1;
+    for (int i = 0; i < n; i++)
+        if (faixas[i].erro)
+            ok = 0;
+    for (int i = 0; ok && i < n; i++)
+        for (int c = 0; c < 256; c++)
+            frequencias[c] += faixas[i].frequencias[c];
+
+    free(faixas);
+    free(threads);
+    return ok;
+}
+
+// Com threads_contagem > 1, divide a entrada restante do leitor entre as
+// threads; o leitor termina esgotado, como na contagem serial
+int contar_frequencias_leitor_paralelo(Leitor *leitor, uint64_t *frequencias)
+{
+    if (!leitor->arquivo)
+    {
+        if (!contar_frequencias_paralelo(leitor->dados, -1, 0, leitor->capacidade, frequencias))
+            return 0;
+        leitor->tamanho = 0;
+        leitor->capacidade = 0;
+        return 1;
+    }
+
+    struct stat info;
+    off_t inicio = ftello(leitor->arquivo);
+    if (inicio < 0 || fstat(fileno(leitor->arquivo), &info) != 0 || !S_ISREG(info.st_mode) ||
+        info.st_size <= inicio)
+        return 0;
+    if (!contar_frequencias_paralelo(NULL, fileno(leitor->arquivo), (uint64_t) inicio,
+                                     (uint64_t) (info.st_size - inicio), frequencias))
+        return 0;
+    fseeko(leitor->arquivo, 0, SEEK_END);
+    leitor->tamanho = 0;
+    return 1;
+}
+
+void contar_frequencias(Leitor *leitor, uint64_t *frequencias)
+{
+    if (threads_contagem > 1 && contar_frequencias_leitor_paralelo(leitor, frequencias))
+        return;
+
+    while (recarregar_leitor(leitor))
+    {
+        contar_frequencias_bloco(leitor->dados, leitor->tamanho, frequencias);
+    }
+}
+
+// Preenche "ordem" com os bytes presentes, em ordem crescente de frequência
+// (empates pelo byte), e retorna quantos são. Radix sort estável, um byte da
+// frequência por passada e só os bytes que a maior frequência usa
+int ordenar_folhas(const uint64_t *frequencias, BYTE *ordem)
+{
+    BYTE auxiliar[256];
+    BYTE *de = ordem, *para = auxiliar;
+    uint64_t maior = 0;
+    int n = 0;
+    for (int c = 0; c < 256; c++)
+    {
+        if (frequencias[c])
+        {
+            ordem[n++] = (BYTE) c;
+            if (frequencias[c] > maior)
+                maior = frequencias[c];
+        }
+    }
+
+    for (int deslocamento = 0; deslocamento < 64 && (maior >> deslocamento); deslocamento += 8)
+    {
+        int posicao[257] = {0};
+        for (int i = 0; i < n; i++)
+            posicao[((frequencias[de[i]] >> deslocamento) & 0xFF) + 1]++;
+        for (int d = 0; d < 256; d++)
+            posicao[d + 1] += posicao[d];
+        for (int i = 0; i < n; i++)
+            para[posicao[(frequencias[de[i]] >> deslocamento) & 0xFF]++] = de[i];
+        BYTE *troca = de;
+        de = para;
+        para = troca;
+    }
+    if (de != ordem)
+        memcpy(ordem, de, n);
+    return n;
+}
+
+// Monta a árvore na arena (esvaziada antes) e retorna o índice da raiz,
+// ou SEM_NO sem símbolos. Com as folhas ordenadas, os nós internos já nascem
+// em ordem crescente de frequência: folhas e internos são duas filas
+// ordenadas e o menor está sempre na frente de uma delas, sem heap
+int construir_arvore(Arena *arena, uint64_t *frequencias)
+{
+    BYTE ordem[256];
+    int n = ordenar_folhas(frequencias, ordem);
+    iniciar_arena(arena);
+    for (int i = 0; i < n; i++)
+        criar_no(arena, ordem[i], frequencias[ordem[i]], SEM_NO, SEM_NO);
+
+    int folha = 0, interno = n;
+    while ((n - folha) + (arena->usados - interno) > 1)
+    {
+        int menores[2];
+        for (int k = 0; k < 2; k++)
+        {
+            if (folha < n && (interno == arena->usados ||
+                              arena->nos[folha].frequencia <= arena->nos[interno].frequencia))
+                menores[k] = folha++;
+            else
+                menores[k] = interno++;
+        }
+        criar_no(arena, '*', arena->nos[menores[0]].frequencia + arena->nos[menores[1]].frequencia,
+                 menores[0], menores[1]);
+    }
+
+    return n ? arena->usados - 1 : SEM_NO;
+}
+
+// Retorna 0 se algum código passar de 64 bits
+int gerar_codigos(const Arena *arena, int raiz, Codigo *tabela, uint64_t codigo, int nivel)
+{
+    if (raiz == SEM_NO)
+        return 1;
+
+    const No *no = &arena->nos[raiz];
+    if (eh_folha(no))
+    {
+        tabela[no->caractere].codigo = codigo;
+        tabela[no->caractere].bits = nivel;
+        return 1;
+    }
+
+    if (nivel == 64)
+        return 0;
+
+    return gerar_codigos(arena, no->esquerda, tabela, codigo << 1, nivel + 1) &&
+           gerar_codigos(arena, no->direita, tabela, (codigo << 1) | 1, nivel + 1);
+}
+
+// Códigos canônicos: os códigos são atribuídos em ordem de (comprimento,
+// símbolo), então o arquivo só precisa guardar os comprimentos
+
+#define MARCADOR_0 0xFF
+#define MARCADOR_1 'H'
+#define MARCADOR_2 'F'
+#define VERSAO_CANONICA 1
+#define TAMANHO_MAXIMO_CODIGO 64
+
+// Preenche "simbolos" em ordem canônica e retorna quantos são. Os bytes
+// presentes são separados sem desvios e só eles passam pela ordenação por
+// contagem: contar os ausentes fazia cada incremento esperar o anterior
+int ordenar_canonico(Codigo *tabela, BYTE *simbolos)
+{
+    BYTE presentes[256];
+    int n = 0;
+    for (int c = 0; c < 256; c++)
+    {
+        presentes[n] = (BYTE) c;
+        n += tabela[c].bits != 0;
+    }
+
+    int contagem[TAMANHO_MAXIMO_CODIGO + 1] = {0};
+    int posicao[TAMANHO_MAXIMO_CODIGO + 1];
+    for (int i = 0; i < n; i++)
+        contagem[tabela[presentes[i]].bits]++;
+    for (int bits = 1, soma = 0; bits <= TAMANHO_MAXIMO_CODIGO; bits++)
+    {
+        posicao[bits] = soma;
+        soma += contagem[bits];
+    }
+    for (int i = 0; i < n; i++)
+        simbolos[posicao[tabela[presentes[i]].bits]++] = presentes[i];
+    return n;
+}
+
+void gerar_codigos_canonicos(Codigo *tabela)
+{
+    BYTE simbolos[256];
+    int n = ordenar_canonico(tabela, simbolos);
+
+    uint64_t codigo = 0;
+    int bits_anterior = n ? tabela[simbolos[0]].bits : 0;
+    for (int i = 0; i < n; i++)
+    {
+        Codigo *cod = &tabela[simbolos[i]];
+        codigo <<= cod->bits - bits_anterior;
+        cod->codigo = codigo++;
+        bits_anterior = cod->bits;
+    }
+}
+
+// Comprimentos a partir da árvore; um único símbolo ainda precisa de 1 bit
+int gerar_comprimentos(const Arena *arena, int raiz, Codigo *tabela)
+{
+    if (!gerar_codigos(arena, raiz, tabela, 0, 0))
+        return 0;
+    if (raiz != SEM_NO && eh_folha(&arena->nos[raiz]))
+        tabela[arena->nos[raiz].caractere].bits = 1;
+    return 1;
+}
+
+// Cabeçalho de um bloco: lixo(1; os bits acima dos 3 de lixo são flags)
+// símbolos(2) e, havendo símbolos,
+// comprimento máximo(1), quantos códigos há de cada comprimento menor que
+// o máximo (o último é deduzido) e os símbolos em ordem canônica.
+// Com FLAG_CRU, o bloco não foi compactado: depois do primeiro byte vêm os
+// dados originais
+#define TAMANHO_MAXIMO_CABECALHO (4 + TAMANHO_MAXIMO_CODIGO + 256)
+#define FLAG_CRU 0x10
+
+int escrever_cabecalho_bloco(Escritor *out, Codigo *tabela, int trash_bits)
+{
+    BYTE simbolos[256];
+    int n = ordenar_canonico(tabela, simbolos);
+    int max_bits = n ? tabela[simbolos[n - 1]].bits : 0;
+
+    BYTE inicio[3] = { (BYTE) trash_bits, (BYTE) (n >> 8), (BYTE) (n & 0xFF) };
+    escrever_bytes(out, inicio, sizeof(inicio));
+    if (n == 0)
+        return sizeof(inicio);
+
+    int contagem[TAMANHO_MAXIMO_CODIGO + 1] = {0};
+    for (int i = 0; i < n; i++)
+        contagem[tabela[simbolos[i]].bits]++;
+
+    escrever_byte(out, (BYTE) max_bits);
+    for (int bits = 1; bits < max_bits; bits++)
+        escrever_byte(out, (BYTE) contagem[bits]);
+    escrever_bytes(out, simbolos, n);
+
+    return sizeof(inicio) + max_bits + n;
+}
+
+// Lê o cabeçalho de um bloco; retorna quantos bytes ocupou ou 0 se inválido
+size_t ler_cabecalho_bloco(const BYTE *dados, size_t tamanho, Codigo *tabela, int *trash_bits)
+{
+    if (tamanho < 1)
+        return 0;
+
+    *trash_bits = dados[0] & 7;
+    if (dados[0] & FLAG_CRU)
+        return 1;
+    if (tamanho < 3)
+        return 0;
+
+    int n = (dados[1] << 8) | dados[2];
+    if (n == 0)
+        return 3;
+    if (n > 256 || tamanho < 4)
+        return 0;
+
+    int max_bits = dados[3];
+    if (max_bits < 1 || max_bits > TAMANHO_MAXIMO_CODIGO || tamanho < (size_t) (3 + max_bits + n))
+        return 0;
+
+    // Os comprimentos precisam formar um código de prefixo válido
+    int contagem[TAMANHO_MAXIMO_CODIGO + 1] = {0};
+    int soma = 0;
+    uint64_t livres = 1;
+    for (int bits = 1; bits <= max_bits; bits++)
+    {
+        contagem[bits] = bits < max_bits ? dados[3 + bits] : n - soma;
+        soma += contagem[bits];
+        livres = livres * 2;
+        if (contagem[bits] < 0 || (uint64_t) contagem[bits] > livres)
+            return 0;
+        livres -= contagem[bits];
+        if (livres > 512)
+            livres = 512;
+    }
+
+    const BYTE *simbolos = dados + 3 + max_bits;
+    int i = 0;
+    for (int bits = 1; bits <= max_bits; bits++)
+        for (int k = 0; k < contagem[bits]; k++)
+            tabela[simbolos[i++]].bits = bits;
+
+    gerar_codigos_canonicos(tabela);
+    return 3 + max_bits + n;
+}
+
+// Limitação do comprimento dos códigos (package-merge): cada nível junta
+// os itens do nível anterior em pares ("pacotes") e os intercala com as
+// folhas; os 2n-2 itens mais leves do último nível dizem quantas vezes
+// cada símbolo aparece, que é o comprimento do seu código
+
+typedef struct {
+    uint64_t peso;
+    int16_t esquerda, direita;
+    int16_t simbolo;
+} ItemPacote;
+
+int comparar_itens(const void *a, const void *b)
+{
+    uint64_t pa = ((const ItemPacote *) a)->peso, pb = ((const ItemPacote *) b)->peso;
+    return (pa > pb) - (pa < pb);
+}
+
+void contar_ocorrencias(ItemPacote *niveis, int largura, int nivel, int i, Codigo *tabela)
+{
+    ItemPacote *item = &niveis[nivel * largura + i];
+    if (item->simbolo >= 0)
+    {
+        tabela[item->simbolo].bits++;
+        return;
+    }
+    contar_ocorrencias(niveis, largura, nivel - 1, item->esquerda, tabela);
+    contar_ocorrencias(niveis, largura, nivel - 1, item->direita, tabela);
+}
+
+// Recalcula os comprimentos em "tabela" para que nenhum passe de max_bits
+int limitar_comprimentos(uint64_t *frequencias, Codigo *tabela, int max_bits)
+{
+    ItemPacote folhas[256];
+    int n = 0;
+    for (int c = 0; c < 256; c++)
+        if (frequencias[c])
+            folhas[n++] = (ItemPacote) { frequencias[c], -1, -1, (int16_t) c };
+
+    if (n <= 2)
+        return 1;
+    while ((1 << max_bits) < n)
+        max_bits++;
+
+    qsort(folhas, n, sizeof(ItemPacote), comparar_itens);
+
+    int largura = 2 * n;
+    ItemPacote *niveis = (ItemPacote *) malloc((size_t) max_bits * largura * sizeof(ItemPacote));
+    int *tamanhos = (int *) malloc(max_bits * sizeof(int));
+    if (!niveis || !tamanhos)
+    {
+        free(niveis);
+        free(tamanhos);
+        return 0;
+    }
+
+    memcpy(niveis, folhas, n * sizeof(ItemPacote));
+    tamanhos[0] = n;
+    for (int nivel = 1; nivel < max_bits; nivel++)
+    {
+        ItemPacote *anterior = &niveis[(nivel - 1) * largura];
+        ItemPacote *atual = &niveis[nivel * largura];
+        int pacotes = tamanhos[nivel - 1] / 2;
+        int f = 0, p = 0, k = 0;
+
+        while (f < n || p < pacotes)
+        {
+            uint64_t peso_pacote = p < pacotes ? anterior[2 * p].peso + anterior[2 * p + 1].peso : 0;
+            if (p == pacotes || (f < n && folhas[f].peso <= peso_pacote))
+                atual[k++] = folhas[f++];
+            else
+            {
+                atual[k++] = (ItemPacote) { peso_pacote, (int16_t) (2 * p), (int16_t) (2 * p + 1), -1 };
+                p++;
+            }
+        }
+        tamanhos[nivel] = k;
+    }
+
+    for (int c = 0; c < 256; c++)
+        tabela[c].bits = 0;
+    for (int i = 0; i < 2 * n - 2; i++)
+        contar_ocorrencias(niveis, largura, max_bits - 1, i, tabela);
+
+    free(niveis);
+    free(tamanhos);
+    return 1;
+}
+
+uint64_t bits_codificados(uint64_t *frequencias, Codigo *tabela)
+{
+    uint64_t total = 0;
+    for (int c = 0; c < 256; c++)
+        total += frequencias[c] * tabela[c].bits;
+    return total;
+}
+
+// Tamanho que o bloco terá compactado, cabeçalho incluído
+uint64_t tamanho_estimado(uint64_t *frequencias, Codigo *tabela)
+{
+    int simbolos = 0, max_bits = 0;
+    for (int c = 0; c < 256; c++)
+    {
+        if (tabela[c].bits)
+            simbolos++;
+        if (tabela[c].bits > max_bits)
+            max_bits = tabela[c].bits;
+    }
+    uint64_t cabecalho = 3 + (simbolos ? max_bits + simbolos : 0);
+    return cabecalho + (bits_codificados(frequencias, tabela) + 7) / 8;
+}
+
+// Da tabela de frequências aos códigos canônicos, respeitando o limite de
+// max_bits_codigo; com "relatar", informa quanto o limite custou
+int calcular_codigos(uint64_t *frequencias, Codigo *tabela, int relatar)
+{
+    Arena arena;
+    int raiz = construir_arvore(&arena, frequencias);
+    int limite = max_bits_codigo;
+    int maior = 0;
+
+    memset(tabela, 0, 256 * sizeof(Codigo));
+    if (gerar_comprimentos(&arena, raiz, tabela))
+    {
+        for (int c = 0; c < 256; c++)
+            if (tabela[c].bits > maior)
+                maior = tabela[c].bits;
+    }
+    else
+    {
+        // Mais profundo que 64 bits: o limite deixa de ser opcional
+        maior = TAMANHO_MAXIMO_CODIGO + 1;
+        if (limite == 0)
+            limite = TAMANHO_MAXIMO_CODIGO;
+    }
+
+    if (limite > 0 && maior > limite)
+    {
+        uint64_t antes = bits_codificados(frequencias, tabela);
+        if (!limitar_comprimentos(frequencias, tabela, limite))
+            return 0;
+        uint64_t depois = bits_codificados(frequencias, tabela);
+        if (relatar)
+            printf("Códigos limitados de %d para %d bits: dados %.4f%% maiores\n",
+                   maior, limite, antes ? 100.0 * (depois - antes) / antes : 0.0);
+    }
+
+    gerar_codigos_canonicos(tabela);
+    return 1;
+}
+
+// Lê o marcador e a versão do formato; se o arquivo não começar com o
+// marcador, volta ao início para a leitura do header antigo e retorna 0
+int ler_marcador(FILE *in)
+{
+    BYTE marcador[4];
+    if (fread(marcador, sizeof(BYTE), 4, in) == 4 &&
+        marcador[0] == MARCADOR_0 && marcador[1] == MARCADOR_1 && marcador[2] == MARCADOR_2)
+        return marcador[3];
+    rewind(in);
+    return 0;
+}
+
+void escrever_marcador(Escritor *out, int versao)
+{
+    BYTE marcador[4] = { MARCADOR_0, MARCADOR_1, MARCADOR_2, (BYTE) versao };
+    escrever_bytes(out, marcador, sizeof(marcador));
+}
+
+// Lê do arquivo o cabeçalho de bloco e deixa a posição no início dos dados;
+// "flags" (pode ser NULL) recebe os bits acima dos de lixo
+int ler_cabecalho_arquivo(FILE *in, Codigo *tabela, int *trash_bits, int *flags)
+{
+    BYTE cabecalho[TAMANHO_MAXIMO_CABECALHO];
+    long inicio = ftell(in);
+    size_t lidos = fread(cabecalho, sizeof(BYTE), sizeof(cabecalho), in);
+    size_t usados = ler_cabecalho_bloco(cabecalho, lidos, tabela, trash_bits);
+    if (flags)
+        *flags = lidos ? cabecalho[0] & ~7 : 0;
+    fseek(in, inicio + (long) usados, SEEK_SET);
+    return usados != 0;
+}
+
+// Árvore equivalente aos códigos, usada só quando há códigos longos demais
+// para as tabelas de decodificação; SEM_NO se não couber na arena
+int arvore_de_codigos(Arena *arena, Codigo *tabela)
+{
+    iniciar_arena(arena);
+    int raiz = criar_no(arena, '*', 0, SEM_NO, SEM_NO);
+    for (int c = 0; c < 256; c++)
+    {
+        int atual = raiz;
+        for (int i = tabela[c].bits - 1; i >= 0; i--)
+        {
+            No *no = &arena->nos[atual];
+            int16_t *filho = ((tabela[c].codigo >> i) & 1) ? &no->direita : &no->esquerda;
+            if (*filho == SEM_NO)
+            {
+                int novo = criar_no(arena, i ? '*' : (BYTE) c, 0, SEM_NO, SEM_NO);
+                if (novo == SEM_NO)
+                    return SEM_NO;
+                *filho = (int16_t) novo;
+            }
+            atual = *filho;
+        }
+    }
+    return raiz;
+}
+
+// Decodificação por tabela: os próximos BITS_PRIMARIA bits indexam a tabela
+// primária; prefixos de códigos mais longos apontam para uma tabela
+// secundária, e só códigos maiores que as duas juntas caminham na árvore
+
+#define BITS_PRIMARIA 11
+#define BITS_SECUNDARIA_MAX 12
+
+// Entradas zeradas são inválidas: os índices da primária que não começam
+// nenhum código (só possíveis com dados corrompidos) ficam assim
+#define ENTRADA_INVALIDA 0
+#define ENTRADA_SIMBOLO 1
+#define ENTRADA_SECUNDARIA 2
+#define ENTRADA_ARVORE 3
+
+typedef struct {
+    uint16_t valor;
+    BYTE bits;
+    BYTE tipo;
+} EntradaTabela;
+
+// Árvore plana para os códigos longos: uma entrada de 16 bits por nó, em
+// ordem de largura, de modo que os dois filhos de um nó são vizinhos. Nó
+// interno guarda o índice do filho esquerdo (o direito vem logo depois);
+// folha guarda FOLHA_PLANA | símbolo. Cabe inteira em cerca de 1 KiB
+#define FOLHA_PLANA 0x8000
+#define AUSENTE_PLANA 0x7FFF
+
+typedef struct {
+    EntradaTabela *entradas;
+    uint16_t arvore[MAX_NOS];
+} TabelaDecodificacao;
+
+// Copia a árvore da arena para o formato plano; retorna 0 se não couber
+int achatar_arvore(const Arena *arena, int raiz, uint16_t *plana)
+{
+    int fila[MAX_NOS], posicoes[MAX_NOS];
+    int inicio = 0, fim = 0, livre = 1;
+
+    fila[fim] = raiz;
+    posicoes[fim++] = 0;
+    while (inicio < fim)
+    {
+        const No *no = &arena->nos[fila[inicio]];
+        int pos = posicoes[inicio++];
+        if (eh_folha(no))
+        {
+            plana[pos] = FOLHA_PLANA | no->caractere;
+            continue;
+        }
+
+        if (livre + 2 > MAX_NOS)
+            return 0;
+        plana[pos] = (uint16_t) livre;
+        int filhos[2] = { no->esquerda, no->direita };
+        for (int k = 0; k < 2; k++)
+        {
+            if (filhos[k] == SEM_NO)
+            {
+                plana[livre + k] = AUSENTE_PLANA;
+                continue;
+            }
+            fila[fim] = filhos[k];
+            posicoes[fim++] = livre + k;
+        }
+        livre += 2;
+    }
+    return 1;
+}
+
+// Monta as tabelas em td->entradas, que já tem espaço para *capacidade
+// entradas e só é realocada se não couberem (com *capacidade 0, td->entradas
+// precisa ser NULL). "arvore" e "raiz" indicam uma árvore já montada; sem
+// ela (SEM_NO), monta uma a partir dos códigos se algum for longo demais
+// para as tabelas
+// Repete "entrada" em "n" posições (uma ou uma potência de 2). Grava duas
+// entradas por vez: escritas uma a uma, o preenchimento da primária era a
+// maior parte do custo de preparar a tabela para uma mensagem curta
+static inline void preencher_entradas(EntradaTabela *destino, EntradaTabela entrada, size_t n)
+{
+    if (n == 1)
+    {
+        *destino = entrada;
+        return;
+    }
+
+    uint32_t uma;
+    memcpy(&uma, &entrada, sizeof(uma));
+    uint64_t par = (uint64_t) uma << 32 | uma;
+    for (size_t k = 0; k < n; k += 2)
+        memcpy(destino + k, &par, sizeof(par));
+}
+
+int preparar_tabela_decodificacao(TabelaDecodificacao *td, size_t *capacidade, Codigo *tabela,
+                                  const Arena *arvore, int raiz)
+{
+    BYTE bits_secundaria[1 << BITS_PRIMARIA] = {0};
+    int maior = 0;
+    for (int c = 0; c < 256; c++)
+        if (tabela[c].bits > maior)
+            maior = tabela[c].bits;
+    td->arvore[0] = AUSENTE_PLANA;
+    if (raiz != SEM_NO)
+    {
+        if (!achatar_arvore(arvore, raiz, td->arvore))
+            return 0;
+    }
+    else if (maior > BITS_PRIMARIA + BITS_SECUNDARIA_MAX)
+    {
+        Arena arena;
+        raiz = arvore_de_codigos(&arena, tabela);
+        if (raiz == SEM_NO || !achatar_arvore(&arena, raiz, td->arvore))
+            return 0;
+    }
+
+    // Quantos bits cada tabela secundária precisa indexar; os prefixos que
+    // têm uma ficam em uma lista, para não percorrer a primária inteira.
+    // "cobertas" conta as entradas da primária que serão escritas abaixo
+    int prefixos[256];
+    int num_prefixos = 0;
+    size_t cobertas = 0;
+    for (int c = 0; c < 256; c++)
+    {
+        int extra = tabela[c].bits - BITS_PRIMARIA;
+        if (extra <= 0)
+        {
+            if (tabela[c].bits)
+                cobertas += (size_t) 1 << -extra;
+            continue;
+        }
+        uint64_t prefixo = tabela[c].codigo >> extra;
+        if (extra > BITS_SECUNDARIA_MAX)
+            extra = BITS_SECUNDARIA_MAX;
+        if (!bits_secundaria[prefixo])
+            prefixos[num_prefixos++] = (int) prefixo;
+        if (extra > bits_secundaria[prefixo])
+            bits_secundaria[prefixo] = (BYTE) extra;
+    }
+    cobertas += num_prefixos;
+
+    size_t total = 1 << BITS_PRIMARIA;
+    for (int i = 0; i < num_prefixos; i++)
+        total += (size_t) 1 << bits_secundaria[prefixos[i]];
+
+    if (total > *capacidade)
+    {
+        EntradaTabela *maior = (EntradaTabela *) realloc(td->entradas, total * sizeof(EntradaTabela));
+        if (!maior)
+            return 0;
+        td->entradas = maior;
+        *capacidade = total;
+        memset(td->entradas, 0, total * sizeof(EntradaTabela));
+    }
+    // Zeradas, as entradas começam inválidas (ENTRADA_INVALIDA). Um código
+    // completo escreve a primária inteira, e só os incompletos (um símbolo,
+    // dados corrompidos) precisam limpar o que sobrou do bloco anterior
+    else if (cobertas < ((size_t) 1 << BITS_PRIMARIA))
+        memset(td->entradas, 0, ((size_t) 1 << BITS_PRIMARIA) * sizeof(EntradaTabela));
+
+    EntradaTabela caminho = { 0, 0, ENTRADA_ARVORE };
+    size_t proxima = 1 << BITS_PRIMARIA;
+    for (int i = 0; i < num_prefixos; i++)
+    {
+        int p = prefixos[i];
+        td->entradas[p].tipo = ENTRADA_SECUNDARIA;
+        td->entradas[p].valor = (uint16_t) proxima;
+        td->entradas[p].bits = (BYTE) bits_secundaria[p];
+
+        // Começa caminhando na árvore; os códigos que cabem sobrescrevem abaixo
+        preencher_entradas(td->entradas + proxima, caminho, (size_t) 1 << bits_secundaria[p]);
+        proxima += (size_t) 1 << bits_secundaria[p];
+    }
+
+    for (int c = 0; c < 256; c++)
+    {
+        int n = tabela[c].bits;
+        if (n == 0 || n > BITS_PRIMARIA + BITS_SECUNDARIA_MAX)
+            continue;
+
+        EntradaTabela entrada = { (uint16_t) c, (BYTE) n, ENTRADA_SIMBOLO };
+        if (n <= BITS_PRIMARIA)
+        {
+            size_t inicio = (size_t) tabela[c].codigo << (BITS_PRIMARIA - n);
+            preencher_entradas(td->entradas + inicio, entrada, (size_t) 1 << (BITS_PRIMARIA - n));
+        }
+        else
+        {
+            int extra = n - BITS_PRIMARIA;
+            EntradaTabela *sec = &td->entradas[tabela[c].codigo >> extra];
+            size_t sufixo = tabela[c].codigo & (((uint64_t) 1 << extra) - 1);
+            size_t inicio = sec->valor + (sufixo << (sec->bits - extra));
+            preencher_entradas(td->entradas + inicio, entrada, (size_t) 1 << (sec->bits - extra));
+        }
+    }
+
+    return 1;
+}
+
+void liberar_tabela_decodificacao(TabelaDecodificacao *td)
+{
+    free(td->entradas);
+    td->entradas = NULL;
+}
+
+int montar_tabela_decodificacao(TabelaDecodificacao *td, Codigo *tabela, const Arena *arvore, int raiz)
+{
+    size_t capacidade = 0;
+    td->entradas = NULL;
+    if (preparar_tabela_decodificacao(td, &capacidade, tabela, arvore, raiz))
+        return 1;
+    liberar_tabela_decodificacao(td);
+    return 0;
+}
+
+#define FIM_DOS_DADOS (-1)
+#define CAMINHO_INVALIDO (-2)
+
+// Decodifica um símbolo de "lb"; retorna o byte, FIM_DOS_DADOS ou
+// CAMINHO_INVALIDO. Inline para o laço de decodificação não pagar a chamada
+static inline int decodificar_simbolo(const TabelaDecodificacao *td, LeitorBits *lb)
+{
+    if (lb->bits < BITS_PRIMARIA + BITS_SECUNDARIA_MAX)
+    {
+        recarregar_bits(lb);
+        if (lb->bits == 0)
+            return FIM_DOS_DADOS;
+    }
+
+    EntradaTabela e = td->entradas[lb->acumulador >> (64 - BITS_PRIMARIA)];
+    if (e.tipo == ENTRADA_SECUNDARIA)
+    {
+        uint64_t resto = lb->acumulador << BITS_PRIMARIA;
+        e = td->entradas[e.valor + (resto >> (64 - e.bits))];
+    }
+
+    if (e.tipo == ENTRADA_SIMBOLO)
+    {
+        if (e.bits > lb->bits)
+            return CAMINHO_INVALIDO;
+        consumir_bits(lb, e.bits);
+        return e.valor;
+    }
+    if (e.tipo == ENTRADA_INVALIDA)
+        return CAMINHO_INVALIDO;
+
+    uint16_t no = td->arvore[0];
+    while (!(no & FOLHA_PLANA))
+    {
+        if (no == AUSENTE_PLANA)
+            return CAMINHO_INVALIDO;
+        if (lb->bits == 0)
+        {
+            recarregar_bits(lb);
+            if (lb->bits == 0)
+                return CAMINHO_INVALIDO;
+        }
+        no = td->arvore[no + (lb->acumulador >> 63)];
+        consumir_bits(lb, 1);
+    }
+    return (BYTE) no;
+}
+
+// Decodifica todos os bits de "lb" para "out"; retorna 0 em caminho inválido
+// ou erro na saída (um escritor fixo cheio marca erro e volta ao início, e
+// dados corrompidos podem ir além do tamanho esperado)
+int decodificar_com_tabela(const TabelaDecodificacao *td, LeitorBits *lb, Escritor *out)
+{
+    while (!out->erro)
+    {
+        int simbolo = decodificar_simbolo(td, lb);
+        if (simbolo < 0)
+            return simbolo == FIM_DOS_DADOS;
+        escrever_byte(out, (BYTE) simbolo);
+    }
+    return 0;
+}
+
+void ler_header(FILE *in, int *trash_bits, unsigned short *tree_size)
+{
+    BYTE byte1, byte2;
+    fread(&byte1, sizeof(BYTE), 1, in);
+    fread(&byte2, sizeof(BYTE), 1, in);
+    unsigned short header = (byte1 << 8) | byte2;
+    *trash_bits = header >> 13;
+    *tree_size = header & 0x1FFF;
+}
+
+// Retorna SEM_NO se a árvore gravada não couber na arena
+int reconstruir_arvore(Arena *arena, FILE *in, int *pos)
+{
+    BYTE c;
+    fread(&c, sizeof(BYTE), 1, in);
+    (*pos)--;
+
+    if (c == '*')
+    {
+        int esq = reconstruir_arvore(arena, in, pos);
+        int dir = esq == SEM_NO ? SEM_NO : reconstruir_arvore(arena, in, pos);
+        if (dir == SEM_NO)
+            return SEM_NO;
+        return criar_no(arena, '*', 0, esq, dir);
+    }
+    else if (c == '\\')
+    {
+        fread(&c, sizeof(BYTE), 1, in);
+        (*pos)--;
+    }
+
+    return criar_no(arena, c, 0, SEM_NO, SEM_NO);
+}
+
+// Pré-passada RLE (-r): depois de RLE_MINIMO bytes iguais vem um byte com
+// quantas cópias a mais do mesmo byte seguem (0 a 255), como na primeira
+// etapa do bzip2. Corridas longas viram poucos símbolos, e o codificador
+// só vê uma fração dos bytes. FLAG_RLE no primeiro byte do cabeçalho de
+// bloco indica que os dados do bloco passaram por ela
+
+#define FLAG_RLE 0x08
+#define RLE_MINIMO 4
+#define RLE_MAXIMO 255
+
+typedef struct {
+    int anterior;
+    int repeticoes;
+    int pendentes;
+} EstadoRLE;
+
+void iniciar_rle(EstadoRLE *e)
+{
+    e->anterior = -1;
+    e->repeticoes = 0;
+    e->pendentes = 0;
+}
+
+// Transforma "n" bytes em "saida" (que precisa de n + n / 4 + 1 bytes),
+// continuando a corrida do trecho anterior; retorna quantos bytes saíram
+size_t aplicar_rle(EstadoRLE *e, const BYTE *dados, size_t n, BYTE *saida)
+{
+    size_t m = 0;
+    for (size_t k = 0; k < n; k++)
+    {
+        BYTE b = dados[k];
+        if (e->repeticoes == RLE_MINIMO)
+        {
+            if (b == e->anterior && e->pendentes < RLE_MAXIMO)
+            {
+                e->pendentes++;
+                continue;
+            }
+            saida[m++] = (BYTE) e->pendentes;
+            iniciar_rle(e);
+        }
+        saida[m++] = b;
+        e->repeticoes = b == e->anterior ? e->repeticoes + 1 : 1;
+        e->anterior = b;
+    }
+    return m;
+}
+
+// Fecha uma corrida pendente no fim dos dados; retorna 0 ou 1 byte
+size_t finalizar_rle(EstadoRLE *e, BYTE *saida)
+{
+    if (e->repeticoes != RLE_MINIMO)
+        return 0;
+    saida[0] = (BYTE) e->pendentes;
+    iniciar_rle(e);
+    return 1;
+}
+
+// Próximo trecho da entrada já transformado, lendo até tamanho_bloco_io
+// bytes por vez ("saida" com tamanho_bloco_io + tamanho_bloco_io / 4 + 1
+// bytes); retorna 0 no fim. "crc" (pode ser NULL) acumula o CRC32C da entrada
+size_t ler_trecho_rle(Leitor *leitor, EstadoRLE *e, BYTE *saida, uint32_t *crc)
+{
+    for (;;)
+    {
+        if (leitor->pos == leitor->tamanho && !recarregar_leitor(leitor))
+            return finalizar_rle(e, saida);
+
+        size_t n = leitor->tamanho - leitor->pos;
+        if (n > tamanho_bloco_io)
+            n = tamanho_bloco_io;
+        size_t m = aplicar_rle(e, leitor->dados + leitor->pos, n, saida);
+        if (crc)
+            *crc = atualizar_crc32c(*crc, leitor->dados + leitor->pos, n);
+        leitor->pos += n;
+        if (m)
+            return m;
+    }
+}
+
+// Como decodificar_com_tabela, desfazendo a RLE na saída
+int decodificar_rle(const TabelaDecodificacao *td, LeitorBits *lb, Escritor *out)
+{
+    int anterior = -1, repeticoes = 0;
+    while (!out->erro)
+    {
+        int simbolo = decodificar_simbolo(td, lb);
+        if (simbolo < 0)
+            return simbolo == FIM_DOS_DADOS;
+
+        if (repeticoes == RLE_MINIMO)
+        {
+            for (int k = 0; k < simbolo; k++)
+                escrever_byte(out, (BYTE) anterior);
+            anterior = -1;
+            repeticoes = 0;
+            continue;
+        }
+        escrever_byte(out, (BYTE) simbolo);
+        repeticoes = simbolo == anterior ? repeticoes + 1 : 1;
+        anterior = simbolo;
+    }
+    return 0;
+}
+
+// Com -r: se os dados transformados saem menores, troca a tabela pela deles
+// e retorna FLAG_RLE; senão retorna 0 e mantém a tabela
+int escolher_rle(uint64_t *frequencias, Codigo *tabela, uint64_t *frequencias_rle)
+{
+    Codigo tabela_rle[256];
+    if (!calcular_codigos(frequencias_rle, tabela_rle, 0) ||
+        bits_codificados(frequencias_rle, tabela_rle) >= bits_codificados(frequencias, tabela))
+        return 0;
+    memcpy(tabela, tabela_rle, sizeof(tabela_rle));
+    return FLAG_RLE;
+}
+
+// Inteiros big-endian de até 8 bytes
+
+void escrever_inteiro(Escritor *out, uint64_t valor, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; i--)
+        escrever_byte(out, (BYTE) (valor >> (8 * i)));
+}
+
+uint64_t ler_inteiro(const BYTE *dados, int bytes)
+{
+    uint64_t valor = 0;
+    for (int i = 0; i < bytes; i++)
+        valor = (valor << 8) | dados[i];
+    return valor;
+}
+
+void guardar_inteiro(BYTE *dados, uint64_t valor, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; i--, valor >>= 8)
+        dados[i] = (BYTE) valor;
+}
+
+// Quatro fluxos intercalados (-i, FLAG_INTERCALADO no primeiro byte do
+// cabeçalho de bloco): o símbolo k vai para o fluxo k % 4. Depois do
+// cabeçalho vêm o número de símbolos(8) e o tamanho dos três primeiros
+// fluxos(8 cada); o quarto vai até o fim do bloco. Como os fluxos são
+// independentes, o decodificador avança os quatro na mesma iteração e a CPU
+// sobrepõe as quatro cadeias de consultas em vez de esperar por uma só
+
+#define FLAG_INTERCALADO 0x20
+#define FLUXOS 4
+#define TAMANHO_TABELA_FLUXOS (8 * FLUXOS)
+
+// Contexto reaproveitável (huff_ctx em huff.h): a memória de trabalho dos
+// blocos em memória. Com ele, compactar_bloco e descompactar_bloco só alocam
+// quando um bloco pede mais espaço que os anteriores, e a tabela de
+// decodificação é reaproveitada quando o bloco traz os mesmos códigos que o
+// anterior. Cada thread do modo em blocos usa o seu
+struct huff_ctx {
+    BYTE *rle;
+    size_t capacidade_rle;
+    Escritor fluxos[FLUXOS];
+    TabelaDecodificacao td;
+    size_t capacidade_td;
+    BYTE cabecalho[TAMANHO_MAXIMO_CABECALHO];
+    size_t tamanho_cabecalho;
+};
+
+huff_ctx *huff_ctx_create(void)
+{
+    return (huff_ctx *) calloc(1, sizeof(huff_ctx));
+}
+
+void huff_ctx_free(huff_ctx *ctx)
+{
+    if (!ctx)
+        return;
+    free(ctx->rle);
+    for (int f = 0; f < FLUXOS; f++)
+        free(ctx->fluxos[f].dados);
+    free(ctx->td.entradas);
+    free(ctx);
+}
+
+// "ctx" pode ser NULL; sem ele, os fluxos são alocados e liberados aqui
+int codificar_intercalado(huff_ctx *ctx, const BYTE *dados, size_t n, Codigo *tabela, Escritor *out)
+{
+    Escritor locais[FLUXOS];
+    Escritor *fluxos = ctx ? ctx->fluxos : locais;
+    EscritorBits bits[FLUXOS];
+    int ok = 1;
+    for (int f = 0; f < FLUXOS; f++)
+    {
+        if (!fluxos[f].dados || !ctx)
+            ok = abrir_escritor_memoria(&fluxos[f], n / FLUXOS + 16) && ok;
+        fluxos[f].pos = 0;
+        fluxos[f].erro = 0;
+        iniciar_escritor_bits(&bits[f], &fluxos[f]);
+    }
+
+    size_t k = 0;
+    for (; ok && k + FLUXOS <= n; k += FLUXOS)
+    {
+        for (int f = 0; f < FLUXOS; f++)
+        {
+            Codigo *cod = &tabela[dados[k + f]];
+            escrever_bits(&bits[f], cod->codigo, cod->bits);
+        }
+    }
+    for (int f = 0; ok && k < n; k++, f++)
+    {
+        Codigo *cod = &tabela[dados[k]];
+        escrever_bits(&bits[f], cod->codigo, cod->bits);
+    }
+
+    if (ok)
+    {
+        escrever_inteiro(out, n, 8);
+        for (int f = 0; f < FLUXOS; f++)
+        {
+            finalizar_escritor_bits(&bits[f]);
+            ok = ok && !fluxos[f].erro;
+            if (f < FLUXOS - 1)
+                escrever_inteiro(out, fluxos[f].pos, 8);
+        }
+        for (int f = 0; f < FLUXOS; f++)
+            escrever_bytes(out, fluxos[f].dados, fluxos[f].pos);
+    }
+    for (int f = 0; !ctx && f < FLUXOS; f++)
+        free(fluxos[f].dados);
+    return ok && !out->erro;
+}
+
+// "dados" começa na tabela de fluxos; retorna 0 se estiver corrompido
+int decodificar_intercalado(const TabelaDecodificacao *td, const BYTE *dados, size_t tamanho, Escritor *out)
+{
+    if (tamanho < TAMANHO_TABELA_FLUXOS)
+        return 0;
+
+    uint64_t n = ler_inteiro(dados, 8);
+    Leitor leitores[FLUXOS];
+    LeitorBits lb[FLUXOS];
+    size_t inicio = TAMANHO_TABELA_FLUXOS;
+    for (int f = 0; f < FLUXOS; f++)
+    {
+        uint64_t bytes = f < FLUXOS - 1 ? ler_inteiro(dados + 8 + 8 * f, 8) : tamanho - inicio;
+        if (bytes > tamanho - inicio)
+            return 0;
+        abrir_leitor_memoria(&leitores[f], dados + inicio, (size_t) bytes);
+        iniciar_leitor_bits(&lb[f], &leitores[f], bytes * 8);
+        inicio += (size_t) bytes;
+    }
+
+    for (uint64_t k = 0; k < n / FLUXOS; k++)
+    {
+        int s0 = decodificar_simbolo(td, &lb[0]);
+        int s1 = decodificar_simbolo(td, &lb[1]);
+        int s2 = decodificar_simbolo(td, &lb[2]);
+        int s3 = decodificar_simbolo(td, &lb[3]);
+        if ((s0 | s1 | s2 | s3) < 0 || out->erro)
+            return 0;
+        if (out->capacidade - out->pos < FLUXOS)
+            descarregar_escritor(out);
+        BYTE *p = out->dados + out->pos;
+        p[0] = (BYTE) s0;
+        p[1] = (BYTE) s1;
+        p[2] = (BYTE) s2;
+        p[3] = (BYTE) s3;
+        out->pos += FLUXOS;
+    }
+    for (int f = 0; f < (int) (n % FLUXOS); f++)
+    {
+        int simbolo = decodificar_simbolo(td, &lb[f]);
+        if (simbolo < 0 || out->erro)
+            return 0;
+        escrever_byte(out, (BYTE) simbolo);
+    }
+    return !out->erro;
+}
+
+// Blocos em memória
+
+// Buffer para a RLE de um bloco: o do contexto, crescendo se preciso, ou
+// um novo a cada chamada se não houver contexto
+BYTE *obter_rascunho_rle(huff_ctx *ctx, size_t tamanho)
+{
+    if (!ctx)
+        return (BYTE *) malloc(tamanho);
+    if (tamanho > ctx->capacidade_rle)
+    {
+        BYTE *maior = (BYTE *) realloc(ctx->rle, tamanho);
+        if (!maior)
+            return NULL;
+        ctx->rle = maior;
+        ctx->capacidade_rle = tamanho;
+    }
+    return ctx->rle;
+}
+
+void devolver_rascunho_rle(huff_ctx *ctx, BYTE *rle)
+{
+    if (!ctx)
+        free(rle);
+}
+
+// Compacta "n" bytes no formato de bloco; "out" precisa ser um escritor em
+// memória, pois os bits de lixo são gravados no início do bloco no final
+int compactar_bloco(huff_ctx *ctx, const BYTE *dados, size_t n, Escritor *out)
+{
+    const BYTE *original = dados;
+    size_t n_original = n;
+    uint64_t frequencias[256] = {0};
+    contar_frequencias_bloco(dados, n, frequencias);
+
+    Codigo tabela[256];
+    if (!calcular_codigos(frequencias, tabela, 0))
+        return 0;
+
+    int flags = 0;
+    uint64_t frequencias_rle[256] = {0};
+    BYTE *rle = usar_rle ? obter_rascunho_rle(ctx, n + n / 4 + 2) : NULL;
+    if (rle)
+    {
+        EstadoRLE e;
+        iniciar_rle(&e);
+        size_t m = aplicar_rle(&e, dados, n, rle);
+        m += finalizar_rle(&e, rle + m);
+        contar_frequencias_bloco(rle, m, frequencias_rle);
+        flags = escolher_rle(frequencias, tabela, frequencias_rle);
+        if (flags)
+        {
+            dados = rle;
+            n = m;
+        }
+    }
+
+    // Dados já compactados: guardar como estão sai menor e decodifica com memcpy
+    uint64_t estimado = tamanho_estimado(flags ? frequencias_rle : frequencias, tabela);
+    if (usar_intercalado && !flags)
+        estimado += TAMANHO_TABELA_FLUXOS + FLUXOS - 1;
+    if (estimado >= n_original)
+    {
+        devolver_rascunho_rle(ctx, rle);
+        escrever_byte(out, FLAG_CRU);
+        escrever_bytes(out, original, n_original);
+        return !out->erro;
+    }
+
+    size_t inicio = out->pos;
+    escrever_cabecalho_bloco(out, tabela, 0);
+
+    // Os fluxos intercalados ficam de fora quando a RLE foi usada
+    if (usar_intercalado && !flags)
+    {
+        int ok = codificar_intercalado(ctx, dados, n, tabela, out);
+        devolver_rascunho_rle(ctx, rle);
+        out->dados[inicio] = FLAG_INTERCALADO;
+        return ok;
+    }
+
+    EscritorBits bits;
+    iniciar_escritor_bits(&bits, out);
+    for (size_t k = 0; k < n; k++)
+    {
+        Codigo *cod = &tabela[dados[k]];
+        escrever_bits(&bits, cod->codigo, cod->bits);
+    }
+    int trash_bits = finalizar_escritor_bits(&bits);
+    devolver_rascunho_rle(ctx, rle);
+    if (out->erro)
+        return 0;
+
+    out->dados[inicio] = (BYTE) (trash_bits | flags);
+    return 1;
+}
+
+// Com contexto, a tabela de decodificação dele é reaproveitada quando os
+// códigos (o cabeçalho sem o primeiro byte, que só tem bits de lixo e flags)
+// são os mesmos do bloco anterior, o caso comum de mensagens parecidas
+int descompactar_bloco(huff_ctx *ctx, const BYTE *dados, size_t n, Escritor *out)
+{
+    Codigo tabela[256] = {0};
+    int trash_bits;
+    size_t cabecalho;
+    int reaproveitar = ctx && ctx->tamanho_cabecalho && n >= ctx->tamanho_cabecalho && !(dados[0] & FLAG_CRU) &&
+                       memcmp(dados + 1, ctx->cabecalho + 1, ctx->tamanho_cabecalho - 1) == 0;
+    if (reaproveitar)
+    {
+        cabecalho = ctx->tamanho_cabecalho;
+        trash_bits = dados[0] & 7;
+    }
+    else
+    {
+        cabecalho = ler_cabecalho_bloco(dados, n, tabela, &trash_bits);
+        if (!cabecalho)
+            return 0;
+    }
+    if (dados[0] & FLAG_CRU)
+    {
+        escrever_bytes(out, dados + 1, n - 1);
+        return !out->erro;
+    }
+    // Sem símbolos, não pode haver dados depois do cabeçalho
+    if (cabecalho == 3 && n > cabecalho)
+        return 0;
+
+    TabelaDecodificacao local;
+    TabelaDecodificacao *td = ctx ? &ctx->td : &local;
+    if (!ctx)
+    {
+        if (!montar_tabela_decodificacao(&local, tabela, NULL, SEM_NO))
+            return 0;
+    }
+    else if (!reaproveitar)
+    {
+        ctx->tamanho_cabecalho = 0;
+        if (cabecalho > TAMANHO_MAXIMO_CABECALHO ||
+            !preparar_tabela_decodificacao(td, &ctx->capacidade_td, tabela, NULL, SEM_NO))
+            return 0;
+        memcpy(ctx->cabecalho, dados, cabecalho);
+        ctx->tamanho_cabecalho = cabecalho;
+    }
+
+    Leitor leitor;
+    abrir_leitor_memoria(&leitor, dados + cabecalho, n - cabecalho);
+    LeitorBits lb;
+    uint64_t total_bits = n > cabecalho ? (uint64_t) (n - cabecalho) * 8 - trash_bits : 0;
+    iniciar_leitor_bits(&lb, &leitor, total_bits);
+
+    int ok;
+    if (dados[0] & FLAG_INTERCALADO)
+        ok = decodificar_intercalado(td, dados + cabecalho, n - cabecalho, out);
+    else if (dados[0] & FLAG_RLE)
+        ok = decodificar_rle(td, &lb, out);
+    else
+        ok = decodificar_com_tabela(td, &lb, out);
+    if (!ctx)
+        liberar_tabela_decodificacao(&local);
+    return ok;
+}
+
+// Cabeçalho estendido (versão 6), logo depois do marcador:
+//   flags(2) tamanho original(8) tamanho compactado(8) blocos(4) CRC32C(4)
+// seguido de um cabeçalho de bloco e dos dados. O tamanho compactado conta
+// tudo depois destes campos, então o decodificador não precisa procurar o
+// fim do arquivo e sabe de antemão quanto vai escrever
+
+#define VERSAO_ESTENDIDA 6
+#define TAMANHO_CABECALHO_ESTENDIDO 26
+#define ESTENDIDO_CRC32C 0x0001
+
+typedef struct {
+    int flags;
+    uint64_t original;
+    uint64_t compactado;
+    uint32_t blocos;
+    uint32_t crc;
+} CabecalhoEstendido;
+
+void montar_cabecalho_estendido(BYTE *dados, const CabecalhoEstendido *c)
+{
+    guardar_inteiro(dados, (uint64_t) c->flags, 2);
+    guardar_inteiro(dados + 2, c->original, 8);
+    guardar_inteiro(dados + 10, c->compactado, 8);
+    guardar_inteiro(dados + 18, c->blocos, 4);
+    guardar_inteiro(dados + 22, c->crc, 4);
+}
+
+int interpretar_cabecalho_estendido(const BYTE *dados, CabecalhoEstendido *c)
+{
+    c->flags = (int) ler_inteiro(dados, 2);
+    c->original = ler_inteiro(dados + 2, 8);
+    c->compactado = ler_inteiro(dados + 10, 8);
+    c->blocos = (uint32_t) ler_inteiro(dados + 18, 4);
+    c->crc = (uint32_t) ler_inteiro(dados + 22, 4);
+    return c->blocos == 1;
+}
+
+int ler_cabecalho_estendido(FILE *in, CabecalhoEstendido *c)
+{
+    BYTE dados[TAMANHO_CABECALHO_ESTENDIDO];
+    if (fread(dados, sizeof(BYTE), sizeof(dados), in) != sizeof(dados))
+        return 0;
+    return interpretar_cabecalho_estendido(dados, c);
+}
+
+// Contêiner em blocos independentes (versão 2):
+//   marcador(4) tamanho do bloco(4)
+//   para cada bloco: tamanho compactado(4) tamanho original(4) bloco
+//   terminador: tamanho compactado 0 (4)
+//   índice: posição de cada bloco no arquivo (8 cada)
+//   rodapé: tamanho original(8) número de blocos(8) posição do índice(8)
+// Cada bloco tem seus próprios códigos, então os blocos são compactados em
+// paralelo e escritos em ordem pela thread principal.
+// A versão 7 é o mesmo contêiner com o CRC32C do bloco original depois do
+// tamanho original (prefixo de 12 bytes); é a que o programa grava, e a 2
+// continua sendo lida
+
+#define VERSAO_BLOCOS 2
+#define VERSAO_BLOCOS_CRC 7
+#define TAMANHO_RODAPE 24
+
+int eh_conteiner(int versao)
+{
+    return versao == VERSAO_BLOCOS || versao == VERSAO_BLOCOS_CRC;
+}
+
+size_t tamanho_prefixo_bloco(int versao)
+{
+    return versao == VERSAO_BLOCOS_CRC ? 12 : 8;
+}
+
+// O CRC gravado confere com o bloco descompactado (a versão 2 não tem)
+int conferir_crc_bloco(int versao, const BYTE *campos, const Escritor *bloco)
+{
+    return versao != VERSAO_BLOCOS_CRC ||
+           ler_inteiro(campos + 8, 4) == atualizar_crc32c(0, bloco->dados, bloco->pos);
+}
+
+typedef struct {
+    const char *entrada;
+    const BYTE *mapa;
+    uint64_t tamanho_entrada;
+    size_t tamanho_bloco;
+    uint64_t num_blocos;
+    uint64_t proximo;
+    uint64_t escritos;
+    int janela;
+    Escritor *resultados;
+    uint32_t *crcs;
+    int *prontos;
+    int erro;
+    pthread_mutex_t trava;
+    pthread_cond_t mudou;
+} TrabalhoBlocos;
+
+size_t tamanho_do_bloco(TrabalhoBlocos *t, uint64_t i)
+{
+    uint64_t inicio = i * t->tamanho_bloco;
+    uint64_t resto = t->tamanho_entrada - inicio;
+    return resto < t->tamanho_bloco ? (size_t) resto : t->tamanho_bloco;
+}
+
+void* trabalhador_compactacao(void *arg)
+{
+    TrabalhoBlocos *t = (TrabalhoBlocos *) arg;
+    FILE *in = t->mapa ? NULL : fopen(t->entrada, "rb");
+    BYTE *bloco = t->mapa ? NULL : (BYTE *) malloc(t->tamanho_bloco);
+    huff_ctx *ctx = huff_ctx_create();
+
+    for (;;)
+    {
+        pthread_mutex_lock(&t->trava);
+        if (!ctx || (!t->mapa && (!in || !bloco)))
+            t->erro = 1;
+        while (!t->erro && t->proximo < t->num_blocos && t->proximo >= t->escritos + t->janela)
+            pthread_cond_wait(&t->mudou, &t->trava);
+        if (t->erro || t->proximo >= t->num_blocos)
+        {
+            pthread_cond_broadcast(&t->mudou);
+            pthread_mutex_unlock(&t->trava);
+            break;
+        }
+        uint64_t i = t->proximo++;
+        pthread_mutex_unlock(&t->trava);
+
+        size_t n = tamanho_do_bloco(t, i);
+        Escritor *resultado = &t->resultados[i % t->janela];
+        resultado->pos = 0;
+        const BYTE *dados = t->mapa ? t->mapa + i * t->tamanho_bloco : bloco;
+        int ok = 1;
+        if (!t->mapa)
+        {
+            fseek(in, (long) (i * t->tamanho_bloco), SEEK_SET);
+            ok = fread(bloco, sizeof(BYTE), n, in) == n;
+        }
+        ok = ok && compactar_bloco(ctx, dados, n, resultado);
+        t->crcs[i % t->janela] = atualizar_crc32c(0, dados, n);
+
+        pthread_mutex_lock(&t->trava);
+        if (!ok)
+            t->erro = 1;
+        t->prontos[i % t->janela] = 1;
+        pthread_cond_broadcast(&t->mudou);
+        pthread_mutex_unlock(&t->trava);
+    }
+
+    huff_ctx_free(ctx);
+    free(bloco);
+    if (in) fclose(in);
+    return NULL;
+}
+
+void compactar_em_blocos(const char *entrada, const char *saida)
+{
+    FILE *in = fopen(entrada, "rb");
+    if (!in)
+    {
+        printf("Erro ao abrir arquivo de entrada\n");
+        return;
+    }
+    fseek(in, 0, SEEK_END);
+    uint64_t tamanho_entrada = (uint64_t) ftell(in);
+    Mapeamento mapa;
+    mapear_arquivo(in, &mapa);
+
+    TrabalhoBlocos t;
+    t.entrada = entrada;
+    t.mapa = mapa.dados;
+    t.tamanho_entrada = tamanho_entrada;
+    t.tamanho_bloco = tamanho_bloco_conteiner;
+    t.num_blocos = (tamanho_entrada + t.tamanho_bloco - 1) / t.tamanho_bloco;
+    t.proximo = 0;
+    t.escritos = 0;
+    t.janela = 2 * num_threads;
+    t.erro = 0;
+    t.resultados = (Escritor *) calloc(t.janela, sizeof(Escritor));
+    t.crcs = (uint32_t *) calloc(t.janela, sizeof(uint32_t));
+    t.prontos = (int *) calloc(t.janela, sizeof(int));
+    uint64_t *indice = (uint64_t *) malloc((t.num_blocos + 1) * sizeof(uint64_t));
+    pthread_t *threads = (pthread_t *) malloc(num_threads * sizeof(pthread_t));
+
+    FILE *out = fopen(saida, "wb");
+    Escritor escritor;
+    int ok = out && t.resultados && t.crcs && t.prontos && indice && threads && abrir_escritor(&escritor, out);
+    for (int j = 0; ok && j < t.janela; j++)
+        ok = abrir_escritor_memoria(&t.resultados[j], t.tamanho_bloco + TAMANHO_MAXIMO_CABECALHO);
+    if (!ok)
+    {
+        printf("Erro ao preparar a compactação em blocos\n");
+        if (out) fclose(out);
+        for (int j = 0; t.resultados && j < t.janela; j++)
+            free(t.resultados[j].dados);
+        free(t.resultados);
+        free(t.crcs);
+        free(t.prontos);
+        free(indice);
+        free(threads);
+        desmapear_arquivo(&mapa);
+        fclose(in);
+        return;
+    }
+
+    pthread_mutex_init(&t.trava, NULL);
+    pthread_cond_init(&t.mudou, NULL);
+    int criadas = 0;
+    while (criadas < num_threads && pthread_create(&threads[criadas], NULL, trabalhador_compactacao, &t) == 0)
+        criadas++;
+    if (criadas == 0)
+        t.erro = 1;
+
+    escrever_marcador(&escritor, VERSAO_BLOCOS_CRC);
+    escrever_inteiro(&escritor, t.tamanho_bloco, 4);
+    uint64_t posicao = 8;
+
+    for (uint64_t i = 0; i < t.num_blocos; i++)
+    {
+        Escritor *resultado = &t.resultados[i % t.janela];
+
+        pthread_mutex_lock(&t.trava);
+        while (!t.prontos[i % t.janela] && !t.erro)
+            pthread_cond_wait(&t.mudou, &t.trava);
+        pthread_mutex_unlock(&t.trava);
+        if (t.erro)
+            break;
+
+        indice[i] = posicao;
+        escrever_inteiro(&escritor, resultado->pos, 4);
+        escrever_inteiro(&escritor, tamanho_do_bloco(&t, i), 4);
+        escrever_inteiro(&escritor, t.crcs[i % t.janela], 4);
+        escrever_bytes(&escritor, resultado->dados, resultado->pos);
+        posicao += 12 + resultado->pos;
+
+        pthread_mutex_lock(&t.trava);
+        t.prontos[i % t.janela] = 0;
+        t.escritos++;
+        pthread_cond_broadcast(&t.mudou);
+        pthread_mutex_unlock(&t.trava);
+    }
+
+    for (int j = 0; j < criadas; j++)
+        pthread_join(threads[j], NULL);
+
+    // Depois de um erro, o índice teria posições de blocos que não foram
+    // escritos: o arquivo incompleto é apagado em vez de ganhar rodapé
+    if (!t.erro)
+    {
+        escrever_inteiro(&escritor, 0, 4);
+        posicao += 4;
+        for (uint64_t i = 0; i < t.num_blocos; i++)
+            escrever_inteiro(&escritor, indice[i], 8);
+        escrever_inteiro(&escritor, tamanho_entrada, 8);
+        escrever_inteiro(&escritor, t.num_blocos, 8);
+        escrever_inteiro(&escritor, posicao, 8);
+    }
+    fechar_escritor(&escritor);
+    if (fclose(out) != 0 || escritor.erro)
+        t.erro = 1;
+    if (t.erro)
+        remove(saida);
+
+    for (int j = 0; j < t.janela; j++)
+        free(t.resultados[j].dados);
+    free(t.resultados);
+    free(t.crcs);
+    free(t.prontos);
+    free(indice);
+    free(threads);
+    desmapear_arquivo(&mapa);
+    fclose(in);
+    pthread_mutex_destroy(&t.trava);
+    pthread_cond_destroy(&t.mudou);
+
+    if (t.erro)
+        printf("Erro ao compactar os blocos\n");
+    else
+        printf("Arquivo compactado com sucesso! (%llu blocos, %d threads)\n",
+               (unsigned long long) t.num_blocos, criadas);
+}
+
+// Lê o rodapé do contêiner (a posição do arquivo é alterada)
+int ler_rodape(FILE *in, uint64_t *original, uint64_t *blocos, uint64_t *pos_indice)
+{
+    BYTE rodape[TAMANHO_RODAPE];
+    if (fseek(in, -TAMANHO_RODAPE, SEEK_END) != 0 ||
+        fread(rodape, sizeof(BYTE), TAMANHO_RODAPE, in) != TAMANHO_RODAPE)
+        return 0;
+
+    *original = ler_inteiro(rodape, 8);
+    *blocos = ler_inteiro(rodape + 8, 8);
+    *pos_indice = ler_inteiro(rodape + 16, 8);
+    return 1;
+}
+
+// O índice precisa ocupar exatamente o espaço entre sua posição e o rodapé,
+// o que limita o número de blocos pelo tamanho do arquivo, e os blocos
+// precisam cobrir o tamanho original
+int rodape_valido(uint64_t tamanho_arquivo, uint64_t tamanho_bloco, uint64_t original, uint64_t blocos,
+                  uint64_t pos_indice)
+{
+    if (tamanho_bloco == 0 || tamanho_arquivo < TAMANHO_RODAPE || pos_indice > tamanho_arquivo - TAMANHO_RODAPE)
+        return 0;
+    uint64_t espaco = tamanho_arquivo - TAMANHO_RODAPE - pos_indice;
+    return espaco % 8 == 0 && blocos == espaco / 8 &&
+           blocos == original / tamanho_bloco + (original % tamanho_bloco != 0);
+}
+
+// Depois do terminador vêm o índice, que aqui só é pulado, e o rodapé, que
+// precisa bater com os blocos lidos em sequência; nada pode vir depois
+int conferir_fim_conteiner(FILE *in, uint64_t blocos, uint64_t original, uint64_t pos_indice)
+{
+    BYTE rodape[TAMANHO_RODAPE];
+    for (uint64_t i = 0; i < blocos; i++)
+        if (fread(rodape, sizeof(BYTE), 8, in) != 8)
+            return 0;
+    return fread(rodape, sizeof(BYTE), TAMANHO_RODAPE, in) == TAMANHO_RODAPE &&
+           ler_inteiro(rodape, 8) == original && ler_inteiro(rodape + 8, 8) == blocos &&
+           ler_inteiro(rodape + 16, 8) == pos_indice && fgetc(in) == EOF;
+}
+
+// Lê os blocos em sequência, sem depender do índice. Cada bloco é
+// descompactado em memória para o CRC ser conferido antes de ir para "out"
+int descompactar_blocos(FILE *in, int versao, Escritor *out)
+{
+    BYTE campos[12];
+    size_t prefixo = tamanho_prefixo_bloco(versao);
+    if (fread(campos, sizeof(BYTE), 4, in) != 4)
+        return 0;
+    size_t tamanho_bloco = (size_t) ler_inteiro(campos, 4);
+
+    size_t capacidade = tamanho_bloco + TAMANHO_MAXIMO_CABECALHO;
+    BYTE *bloco = (BYTE *) malloc(capacidade);
+    Escritor saida;
+    huff_ctx *ctx = huff_ctx_create();
+    int ok = bloco && ctx && tamanho_bloco > 0 && abrir_escritor_memoria(&saida, tamanho_bloco);
+    if (!ok)
+        saida.dados = NULL;
+
+    uint64_t num_blocos = 0, total = 0, posicao = 8;
+    int terminado = 0;
+    while (ok && fread(campos, sizeof(BYTE), 4, in) == 4)
+    {
+        size_t compactado = (size_t) ler_inteiro(campos, 4);
+        if (compactado == 0)
+        {
+            terminado = 1;
+            break;
+        }
+        if (fread(campos + 4, sizeof(BYTE), prefixo - 4, in) != prefixo - 4)
+        {
+            ok = 0;
+            break;
+        }
+        size_t original = (size_t) ler_inteiro(campos + 4, 4);
+
+        if (compactado > capacidade)
+        {
+            BYTE *maior = (BYTE *) realloc(bloco, compactado);
+            if (!maior)
+            {
+                ok = 0;
+                break;
+            }
+            bloco = maior;
+            capacidade = compactado;
+        }
+
+        saida.pos = 0;
+        ok = fread(bloco, sizeof(BYTE), compactado, in) == compactado &&
+             descompactar_bloco(ctx, bloco, compactado, &saida) && !saida.erro &&
+             saida.pos == original && conferir_crc_bloco(versao, campos, &saida);
+        if (ok)
+            escrever_bytes(out, saida.dados, saida.pos);
+        num_blocos++;
+        total += original;
+        posicao += prefixo + compactado;
+    }
+
+    // Sem o terminador, o arquivo foi cortado
+    ok = ok && terminado && conferir_fim_conteiner(in, num_blocos, total, posicao + 4);
+    huff_ctx_free(ctx);
+    free(saida.dados);
+    free(bloco);
+    return ok;
+}
+
+// Descompactação paralela: o índice diz onde cada bloco começa e, como só
+// o último bloco pode ser menor, o bloco i vai para a posição i * tamanho do
+// bloco na saída, escrita com pwrite sem precisar de ordem entre as threads
+
+typedef struct {
+    const char *entrada;
+    Mapeamento mapa;
+    int fd_saida;
+    int versao;
+    size_t tamanho_bloco;
+    uint64_t tamanho_original;
+    uint64_t num_blocos;
+    uint64_t *indice;
+    uint64_t proximo;
+    int erro;
+    pthread_mutex_t trava;
+} TrabalhoDescompactacao;
+
+int escrever_na_posicao(int fd, const BYTE *dados, size_t n, uint64_t posicao)
+{
+    while (n)
+    {
+        ssize_t escritos = pwrite(fd, dados, n, (off_t) posicao);
+        if (escritos <= 0)
+            return 0;
+        dados += escritos;
+        n -= (size_t) escritos;
+        posicao += (uint64_t) escritos;
+    }
+    return 1;
+}
+
+void* trabalhador_descompactacao(void *arg)
+{
+    TrabalhoDescompactacao *t = (TrabalhoDescompactacao *) arg;
+    const BYTE *mapa = t->mapa.dados;
+    FILE *in = mapa ? NULL : fopen(t->entrada, "rb");
+    BYTE *bloco = NULL;
+    size_t capacidade = 0;
+    Escritor saida;
+    size_t prefixo = tamanho_prefixo_bloco(t->versao);
+    huff_ctx *ctx = huff_ctx_create();
+    int ok = (mapa || in) && ctx && abrir_escritor_memoria(&saida, t->tamanho_bloco);
+    if (!ok)
+        saida.dados = NULL;
+
+    while (ok)
+    {
+        pthread_mutex_lock(&t->trava);
+        if (t->erro || t->proximo >= t->num_blocos)
+        {
+            pthread_mutex_unlock(&t->trava);
+            break;
+        }
+        uint64_t i = t->proximo++;
+        pthread_mutex_unlock(&t->trava);
+
+        uint64_t inicio = i * t->tamanho_bloco;
+        uint64_t resto = t->tamanho_original - inicio;
+        size_t esperado = resto < t->tamanho_bloco ? (size_t) resto : t->tamanho_bloco;
+        saida.pos = 0;
+
+        if (mapa)
+        {
+            // Direto do mapeamento, sem cópia
+            const BYTE *campos = mapa + t->indice[i];
+            size_t compactado = t->indice[i] + prefixo <= t->mapa.tamanho ? (size_t) ler_inteiro(campos, 4) : 0;
+            ok = compactado && t->indice[i] + prefixo + compactado <= t->mapa.tamanho &&
+                 ler_inteiro(campos + 4, 4) == esperado &&
+                 descompactar_bloco(ctx, campos + prefixo, compactado, &saida) && saida.pos == esperado &&
+                 conferir_crc_bloco(t->versao, campos, &saida) &&
+                 escrever_na_posicao(t->fd_saida, saida.dados, saida.pos, inicio);
+            continue;
+        }
+
+        BYTE campos[12];
+        if (fseek(in, (long) t->indice[i], SEEK_SET) != 0 || fread(campos, sizeof(BYTE), prefixo, in) != prefixo ||
+            ler_inteiro(campos + 4, 4) != esperado)
+        {
+            ok = 0;
+            break;
+        }
+
+        size_t compactado = (size_t) ler_inteiro(campos, 4);
+        if (compactado > capacidade)
+        {
+            BYTE *maior = (BYTE *) realloc(bloco, compactado);
+            if (!maior)
+            {
+                ok = 0;
+                break;
+            }
+            bloco = maior;
+            capacidade = compactado;
+        }
+
+        ok = fread(bloco, sizeof(BYTE), compactado, in) == compactado &&
+             descompactar_bloco(ctx, bloco, compactado, &saida) && saida.pos == esperado &&
+             conferir_crc_bloco(t->versao, campos, &saida) &&
+             escrever_na_posicao(t->fd_saida, saida.dados, saida.pos, inicio);
+    }
+
+    if (!ok)
+    {
+        pthread_mutex_lock(&t->trava);
+        t->erro = 1;
+        pthread_mutex_unlock(&t->trava);
+    }
+    huff_ctx_free(ctx);
+    free(saida.dados);
+    free(bloco);
+    if (in) fclose(in);
+    return NULL;
+}
+
+// "in" já está depois do marcador; a saída é escrita por descritor
+int descompactar_blocos_paralelo(FILE *in, int versao, const char *entrada, FILE *out)
+{
+    BYTE campo[4];
+    TrabalhoDescompactacao t;
+    uint64_t pos_indice;
+    if (fread(campo, sizeof(BYTE), 4, in) != 4 ||
+        !ler_rodape(in, &t.tamanho_original, &t.num_blocos, &pos_indice))
+        return 0;
+
+    t.entrada = entrada;
+    t.versao = versao;
+    t.fd_saida = fileno(out);
+    t.tamanho_bloco = (size_t) ler_inteiro(campo, 4);
+    t.proximo = 0;
+    t.erro = 0;
+    // ler_rodape deixou a posição no fim do arquivo
+    if (!rodape_valido((uint64_t) ftell(in), t.tamanho_bloco, t.tamanho_original, t.num_blocos, pos_indice) ||
+        t.num_blocos >= SIZE_MAX / sizeof(uint64_t))
+        return 0;
+
+    t.indice = (uint64_t *) malloc((size_t) (t.num_blocos + 1) * sizeof(uint64_t));
+    pthread_t *threads = (pthread_t *) malloc(num_threads * sizeof(pthread_t));
+    int ok = t.indice && threads && fseek(in, (long) pos_indice, SEEK_SET) == 0;
+    for (uint64_t i = 0; ok && i < t.num_blocos; i++)
+    {
+        BYTE entrada_indice[8];
+        if (fread(entrada_indice, sizeof(BYTE), 8, in) != 8)
+        {
+            ok = 0;
+            break;
+        }
+        t.indice[i] = ler_inteiro(entrada_indice, 8);
+    }
+
+    // Reserva o tamanho final de uma vez
+    if (ok && ftruncate(t.fd_saida, (off_t) t.tamanho_original) != 0)
+        ok = 0;
+
+    mapear_arquivo(in, &t.mapa);
+    int criadas = 0;
+    if (ok)
+    {
+        pthread_mutex_init(&t.trava, NULL);
+        while (criadas < num_threads && pthread_create(&threads[criadas], NULL, trabalhador_descompactacao, &t) == 0)
+            criadas++;
+        for (int j = 0; j < criadas; j++)
+            pthread_join(threads[j], NULL);
+        pthread_mutex_destroy(&t.trava);
+        ok = criadas > 0 && !t.erro;
+    }
+
+    desmapear_arquivo(&t.mapa);
+    free(t.indice);
+    free(threads);
+    return ok;
+}
+
+// Huffman adaptativo (FGK): codificador e decodificador partem da mesma
+// árvore, só com o nó NYT ("ainda não transmitido"), e a atualizam a cada
+// símbolo; não há cabeçalho nem segunda passada. Um símbolo novo sai como o
+// código do NYT seguido do byte em 9 bits, e o valor 256 marca o fim.
+// Como não há cabeçalho a reescrever, o CRC32C dos dados originais(4) vem
+// no byte seguinte ao do fim (arquivos antigos terminam ali).
+// Os nós ficam em posições que seguem a numeração do FGK: a raiz na última,
+// e os pesos nunca diminuem de uma posição para a seguinte
+
+#define VERSAO_ADAPTATIVA 5
+#define SIMBOLO_NYT 256
+#define SIMBOLO_FIM 256
+#define BITS_SIMBOLO_NOVO 9
+#define NOS_ADAPTATIVOS 513
+#define RAIZ_ADAPTATIVA (NOS_ADAPTATIVOS - 1)
+
+typedef struct {
+    uint64_t peso[NOS_ADAPTATIVOS];
+    int16_t pai[NOS_ADAPTATIVOS];
+    int16_t esquerda[NOS_ADAPTATIVOS];
+    int16_t direita[NOS_ADAPTATIVOS];
+    int16_t simbolo[NOS_ADAPTATIVOS];
+    int16_t folha[SIMBOLO_NYT + 1];
+} ArvoreAdaptativa;
+
+void iniciar_arvore_adaptativa(ArvoreAdaptativa *a)
+{
+    for (int s = 0; s <= SIMBOLO_NYT; s++)
+        a->folha[s] = SEM_NO;
+    a->peso[RAIZ_ADAPTATIVA] = 0;
+    a->pai[RAIZ_ADAPTATIVA] = SEM_NO;
+    a->esquerda[RAIZ_ADAPTATIVA] = a->direita[RAIZ_ADAPTATIVA] = SEM_NO;
+    a->simbolo[RAIZ_ADAPTATIVA] = SIMBOLO_NYT;
+    a->folha[SIMBOLO_NYT] = RAIZ_ADAPTATIVA;
+}
+
+// Troca o conteúdo de duas posições (de mesmo peso); o pai fica com a posição
+void trocar_nos_adaptativos(ArvoreAdaptativa *a, int x, int y)
+{
+    int16_t esquerda = a->esquerda[x], direita = a->direita[x], simbolo = a->simbolo[x];
+    a->esquerda[x] = a->esquerda[y];
+    a->direita[x] = a->direita[y];
+    a->simbolo[x] = a->simbolo[y];
+    a->esquerda[y] = esquerda;
+    a->direita[y] = direita;
+    a->simbolo[y] = simbolo;
+
+    int posicoes[2] = { x, y };
+    for (int k = 0; k < 2; k++)
+    {
+        int p = posicoes[k];
+        if (a->esquerda[p] == SEM_NO)
+            a->folha[a->simbolo[p]] = (int16_t) p;
+        else
+        {
+            a->pai[a->esquerda[p]] = (int16_t) p;
+            a->pai[a->direita[p]] = (int16_t) p;
+        }
+    }
+}
+
+// Conta mais uma ocorrência de "simbolo", criando a folha se for novo
+void atualizar_arvore_adaptativa(ArvoreAdaptativa *a, int simbolo)
+{
+    int p = a->folha[simbolo];
+    if (p == SEM_NO)
+    {
+        // O NYT vira nó interno com o novo NYT à esquerda e o símbolo à direita
+        int z = a->folha[SIMBOLO_NYT];
+        int filhos[2] = { z - 2, z - 1 };
+        for (int k = 0; k < 2; k++)
+        {
+            a->peso[filhos[k]] = 0;
+            a->pai[filhos[k]] = (int16_t) z;
+            a->esquerda[filhos[k]] = a->direita[filhos[k]] = SEM_NO;
+        }
+        a->simbolo[z - 2] = SIMBOLO_NYT;
+        a->simbolo[z - 1] = (int16_t) simbolo;
+        a->esquerda[z] = (int16_t) (z - 2);
+        a->direita[z] = (int16_t) (z - 1);
+        a->folha[SIMBOLO_NYT] = (int16_t) (z - 2);
+        a->folha[simbolo] = (int16_t) (z - 1);
+        p = z - 1;
+    }
+
+    while (p != SEM_NO)
+    {
+        // Antes de crescer, o nó vai para a maior posição do seu peso
+        int lider = p;
+        while (lider < RAIZ_ADAPTATIVA && a->peso[lider + 1] == a->peso[p])
+            lider++;
+        if (lider != p && lider != a->pai[p])
+        {
+            trocar_nos_adaptativos(a, p, lider);
+            p = lider;
+        }
+        a->peso[p]++;
+        p = a->pai[p];
+    }
+}
+
+// Escreve o caminho da raiz até a posição "p"
+void escrever_caminho(const ArvoreAdaptativa *a, int p, EscritorBits *eb)
+{
+    BYTE caminho[NOS_ADAPTATIVOS];
+    int n = 0;
+    for (; a->pai[p] != SEM_NO; p = a->pai[p])
+        caminho[n++] = a->direita[a->pai[p]] == p;
+
+    while (n)
+    {
+        int parte = n < 32 ? n : 32;
+        uint64_t codigo = 0;
+        for (int i = 0; i < parte; i++)
+            codigo = (codigo << 1) | caminho[--n];
+        escrever_bits(eb, codigo, parte);
+    }
+}
+
+void codificar_adaptativo(ArvoreAdaptativa *a, int simbolo, EscritorBits *eb)
+{
+    if (simbolo != SIMBOLO_FIM && a->folha[simbolo] != SEM_NO)
+    {
+        escrever_caminho(a, a->folha[simbolo], eb);
+        atualizar_arvore_adaptativa(a, simbolo);
+        return;
+    }
+
+    escrever_caminho(a, a->folha[SIMBOLO_NYT], eb);
+    escrever_bits(eb, (uint64_t) simbolo, BITS_SIMBOLO_NOVO);
+    if (simbolo != SIMBOLO_FIM)
+        atualizar_arvore_adaptativa(a, simbolo);
+}
+
+int compactar_adaptativo(FILE *in, FILE *out)
+{
+    ArvoreAdaptativa *arvore = (ArvoreAdaptativa *) malloc(sizeof(ArvoreAdaptativa));
+    Leitor leitor;
+    Mapeamento mapa;
+    Escritor escritor;
+    if (!arvore || !abrir_entrada(&leitor, in, &mapa))
+    {
+        free(arvore);
+        return 0;
+    }
+    if (!abrir_escritor(&escritor, out))
+    {
+        fechar_entrada(&leitor, &mapa);
+        free(arvore);
+        return 0;
+    }
+
+    escrever_marcador(&escritor, VERSAO_ADAPTATIVA);
+    iniciar_arvore_adaptativa(arvore);
+    EscritorBits bits;
+    iniciar_escritor_bits(&bits, &escritor);
+    uint32_t crc = 0;
+    while (recarregar_leitor(&leitor))
+    {
+        crc = atualizar_crc32c(crc, leitor.dados, leitor.tamanho);
+        for (size_t k = 0; k < leitor.tamanho; k++)
+            codificar_adaptativo(arvore, leitor.dados[k], &bits);
+    }
+    codificar_adaptativo(arvore, SIMBOLO_FIM, &bits);
+    finalizar_escritor_bits(&bits);
+    escrever_inteiro(&escritor, crc, 4);
+    fechar_escritor(&escritor);
+    fflush(out);
+
+    int ok = !ferror(in) && !escritor.erro;
+    fechar_entrada(&leitor, &mapa);
+    free(arvore);
+    return ok;
+}
+
+// Decodifica até o símbolo de fim (a posição deve estar logo após o marcador)
+// e confere o CRC32C que vem depois dele; sem CRC, desliga "conferir_crc"
+int descompactar_adaptativo(FILE *in, Escritor *out)
+{
+    ArvoreAdaptativa *arvore = (ArvoreAdaptativa *) malloc(sizeof(ArvoreAdaptativa));
+    Leitor leitor;
+    if (!arvore || !abrir_leitor(&leitor, in))
+    {
+        free(arvore);
+        return 0;
+    }
+
+    LeitorBits lb;
+    iniciar_leitor_bits(&lb, &leitor, UINT64_MAX);
+    iniciar_arvore_adaptativa(arvore);
+    out->conferir_crc = 1;
+
+    int ok = 0;
+    while (!out->erro)
+    {
+        int p = RAIZ_ADAPTATIVA;
+        while (arvore->esquerda[p] != SEM_NO)
+        {
+            if (lb.bits == 0)
+                recarregar_bits(&lb);
+            if (lb.bits == 0)
+                break;
+            p = (lb.acumulador >> 63) ? arvore->direita[p] : arvore->esquerda[p];
+            consumir_bits(&lb, 1);
+        }
+        if (arvore->esquerda[p] != SEM_NO)
+            break;
+
+        int simbolo = arvore->simbolo[p];
+        if (simbolo == SIMBOLO_NYT)
+        {
+            if (lb.bits < BITS_SIMBOLO_NOVO)
+                recarregar_bits(&lb);
+            if (lb.bits < BITS_SIMBOLO_NOVO)
+                break;
+            simbolo = (int) (lb.acumulador >> (64 - BITS_SIMBOLO_NOVO));
+            consumir_bits(&lb, BITS_SIMBOLO_NOVO);
+            if (simbolo == SIMBOLO_FIM)
+            {
+                ok = 1;
+                break;
+            }
+            if (simbolo > SIMBOLO_FIM || arvore->folha[simbolo] != SEM_NO)
+                break;
+        }
+        escrever_byte(out, (BYTE) simbolo);
+        atualizar_arvore_adaptativa(arvore, simbolo);
+    }
+
+    // O acumulador só recebe bytes inteiros: descartando o resto do último
+    // byte, o que sobra é o CRC32C, ou nada
+    BYTE crc[4];
+    int lidos = 0;
+    consumir_bits(&lb, lb.bits % 8);
+    while (ok && lidos < 4)
+    {
+        if (lb.bits < 8)
+            recarregar_bits(&lb);
+        if (lb.bits < 8)
+            break;
+        crc[lidos++] = (BYTE) (lb.acumulador >> 56);
+        consumir_bits(&lb, 8);
+    }
+    if (ok && lb.bits == 0)
+        recarregar_bits(&lb);
+    out->conferir_crc = lidos == 4;
+    ok = ok && lb.bits == 0 && (lidos == 0 || (lidos == 4 && crc_confere(out, (uint32_t) ler_inteiro(crc, 4))));
+
+    fechar_leitor(&leitor);
+    free(arvore);
+    return ok;
+}
+
+// Compactação em fluxo (entrada padrão, pipes): uma só passada, bloco a
+// bloco, no mesmo contêiner em blocos; a memória fica limitada a um bloco
+// de entrada, um compactado e o índice, que só é escrito no final
+int compactar_fluxo(FILE *in, FILE *out)
+{
+    size_t tamanho_bloco = tamanho_bloco_conteiner ? tamanho_bloco_conteiner : TAMANHO_BLOCO_CONTEINER;
+    BYTE *bloco = (BYTE *) malloc(tamanho_bloco);
+    uint64_t *indice = NULL;
+    uint64_t capacidade_indice = 0, num_blocos = 0, total = 0, posicao = 8;
+    Escritor resultado, escritor;
+    resultado.dados = NULL;
+    huff_ctx *ctx = huff_ctx_create();
+
+    int ok = bloco && ctx && abrir_escritor(&escritor, out);
+    if (!ok || !abrir_escritor_memoria(&resultado, tamanho_bloco + TAMANHO_MAXIMO_CABECALHO))
+    {
+        if (ok)
+            fechar_escritor(&escritor);
+        huff_ctx_free(ctx);
+        free(bloco);
+        return 0;
+    }
+
+    escrever_marcador(&escritor, VERSAO_BLOCOS_CRC);
+    escrever_inteiro(&escritor, tamanho_bloco, 4);
+
+    size_t n;
+    while (ok && (n = fread(bloco, sizeof(BYTE), tamanho_bloco, in)) > 0)
+    {
+        if (num_blocos == capacidade_indice)
+        {
+            capacidade_indice = capacidade_indice ? capacidade_indice * 2 : 64;
+            uint64_t *maior = (uint64_t *) realloc(indice, capacidade_indice * sizeof(uint64_t));
+            if (!maior)
+            {
+                ok = 0;
+                break;
+            }
+            indice = maior;
+        }
+
+        resultado.pos = 0;
+        ok = compactar_bloco(ctx, bloco, n, &resultado);
+        indice[num_blocos++] = posicao;
+        escrever_inteiro(&escritor, resultado.pos, 4);
+        escrever_inteiro(&escritor, n, 4);
+        escrever_inteiro(&escritor, atualizar_crc32c(0, bloco, n), 4);
+        escrever_bytes(&escritor, resultado.dados, resultado.pos);
+        posicao += 12 + resultado.pos;
+        total += n;
+
+        // Só o último bloco pode vir incompleto
+        if (n < tamanho_bloco)
+            break;
+    }
+
+    escrever_inteiro(&escritor, 0, 4);
+    for (uint64_t i = 0; i < num_blocos; i++)
+        escrever_inteiro(&escritor, indice[i], 8);
+    escrever_inteiro(&escritor, total, 8);
+    escrever_inteiro(&escritor, num_blocos, 8);
+    escrever_inteiro(&escritor, posicao + 4, 8);
+    fechar_escritor(&escritor);
+    fflush(out);
+
+    ok = ok && !ferror(in) && !escritor.erro;
+    huff_ctx_free(ctx);
+    free(resultado.dados);
+    free(indice);
+    free(bloco);
+    return ok;
+}
+
+int descompactar_fluxo(FILE *in, FILE *out)
+{
+    Escritor escritor;
+    int versao = ler_marcador(in);
+    if ((!eh_conteiner(versao) && versao != VERSAO_ADAPTATIVA) || !abrir_escritor(&escritor, out))
+        return 0;
+
+    int ok = eh_conteiner(versao) ? descompactar_blocos(in, versao, &escritor) : descompactar_adaptativo(in, &escritor);
+    fechar_escritor(&escritor);
+    fflush(out);
+    return ok && !escritor.erro;
+}
+
+// Acesso aleatório: descompacta só os blocos que cobrem [inicio, inicio +
+// tamanho) de um contêiner em blocos, achando-os pelo índice.
+// Retorna quantos bytes foram escritos em "out", ou -1 em erro
+int64_t descompactar_intervalo(const char *entrada, uint64_t inicio, uint64_t tamanho, Escritor *out)
+{
+    FILE *in = fopen(entrada, "rb");
+    if (!in)
+        return -1;
+
+    BYTE campos[12];
+    uint64_t original, num_blocos, pos_indice;
+    int versao = ler_marcador(in);
+    size_t prefixo = tamanho_prefixo_bloco(versao);
+    if (!eh_conteiner(versao) || fread(campos, sizeof(BYTE), 4, in) != 4 ||
+        !ler_rodape(in, &original, &num_blocos, &pos_indice) ||
+        !rodape_valido((uint64_t) ftell(in), ler_inteiro(campos, 4), original, num_blocos, pos_indice))
+    {
+        fclose(in);
+        return -1;
+    }
+
+    uint64_t tamanho_bloco = ler_inteiro(campos, 4);
+    uint64_t fim = inicio + tamanho;
+    if (inicio > original)
+        inicio = original;
+    if (fim > original || fim < inicio)
+        fim = original;
+
+    Escritor bloco_original;
+    bloco_original.dados = NULL;
+    BYTE *bloco = NULL;
+    size_t capacidade = 0;
+    huff_ctx *ctx = huff_ctx_create();
+    int ok = ctx && tamanho_bloco > 0 && abrir_escritor_memoria(&bloco_original, (size_t) tamanho_bloco);
+    uint64_t primeiro = ok ? inicio / tamanho_bloco : 0;
+    uint64_t escritos = 0;
+
+    for (uint64_t i = primeiro; ok && i * tamanho_bloco < fim && i < num_blocos; i++)
+    {
+        if (fseek(in, (long) (pos_indice + 8 * i), SEEK_SET) != 0 || fread(campos, sizeof(BYTE), 8, in) != 8 ||
+            fseek(in, (long) ler_inteiro(campos, 8), SEEK_SET) != 0 || fread(campos, sizeof(BYTE), prefixo, in) != prefixo)
+        {
+            ok = 0;
+            break;
+        }
+
+        size_t compactado = (size_t) ler_inteiro(campos, 4);
+        if (compactado > capacidade)
+        {
+            BYTE *maior = (BYTE *) realloc(bloco, compactado);
+            if (!maior)
+            {
+                ok = 0;
+                break;
+            }
+            bloco = maior;
+            capacidade = compactado;
+        }
+
+        bloco_original.pos = 0;
+        ok = fread(bloco, sizeof(BYTE), compactado, in) == compactado &&
+             descompactar_bloco(ctx, bloco, compactado, &bloco_original) &&
+             conferir_crc_bloco(versao, campos, &bloco_original);
+        if (!ok)
+            break;
+
+        uint64_t comeco_bloco = i * tamanho_bloco;
+        uint64_t de = inicio > comeco_bloco ? inicio - comeco_bloco : 0;
+        uint64_t ate = fim - comeco_bloco < bloco_original.pos ? fim - comeco_bloco : bloco_original.pos;
+        if (de < ate)
+        {
+            escrever_bytes(out, bloco_original.dados + de, (size_t) (ate - de));
+            escritos += ate - de;
+        }
+    }
+
+    free(bloco_original.dados);
+    huff_ctx_free(ctx);
+    free(bloco);
+    fclose(in);
+    return ok ? (int64_t) escritos : -1;
+}
+
+void extrair_trecho(const char *entrada, const char *saida, uint64_t inicio, uint64_t tamanho)
+{
+    FILE *out = fopen(saida, "wb");
+    Escritor escritor;
+    if (!out || !abrir_escritor(&escritor, out))
+    {
+        printf("Erro ao abrir arquivo de saída\n");
+        if (out) fclose(out);
+        return;
+    }
+
+    int64_t escritos = descompactar_intervalo(entrada, inicio, tamanho, &escritor);
+    fechar_escritor(&escritor);
+    fclose(out);
+
+    if (escritos < 0)
+        printf("Erro: o trecho só pode ser extraído de arquivos compactados em blocos (-B) e íntegros\n");
+    else
+        printf("%lld bytes extraídos para %s\n", (long long) escritos, saida);
+}
+
+// Lote com dicionário: para muitos arquivos pequenos, uma tabela de
+// códigos treinada numa amostra fica num arquivo à parte (marcador com 'D'
+// e o cabeçalho de bloco), e cada arquivo compactado guarda só o marcador,
+// o identificador do dicionário(4) e os bits de lixo(1) antes dos dados.
+// Como nos blocos, FLAG_CRU no byte de lixo indica os dados guardados como
+// estão, quando o dicionário não os reduziria. Com FLAG_CRC32C nesse
+// byte, o CRC32C dos dados originais(4) vem logo depois dele (arquivos
+// antigos não o têm)
+
+#define VERSAO_DICIONARIO 3
+#define MARCADOR_DICIONARIO 'D'
+#define TAMANHO_CABECALHO_DICIONARIO 13
+#define FLAG_CRC32C 0x40
+
+typedef struct {
+    Codigo tabela[256];
+    uint32_t identificador;
+    TabelaDecodificacao td;
+} Dicionario;
+
+// Dicionário carregado com -D (NULL: compactação normal)
+Dicionario *dicionario = NULL;
+
+// FNV-1a do cabeçalho gravado: arquivo e dicionário precisam combinar
+uint32_t identificar_dicionario(const BYTE *dados, size_t n)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < n; i++)
+        hash = (hash ^ dados[i]) * 16777619u;
+    return hash;
+}
+
+// Soma as frequências das amostras; todo byte ganha 1 de frequência para
+// que arquivos fora da amostra ainda possam ser codificados
+int treinar_dicionario(const char *saida, char **amostras, int n)
+{
+    uint64_t frequencias[256];
+    for (int c = 0; c < 256; c++)
+        frequencias[c] = 1;
+
+    for (int i = 0; i < n; i++)
+    {
+        FILE *in = fopen(amostras[i], "rb");
+        Leitor leitor;
+        Mapeamento mapa;
+        if (!in)
+            return 0;
+        if (!abrir_entrada(&leitor, in, &mapa))
+        {
+            fclose(in);
+            return 0;
+        }
+        contar_frequencias(&leitor, frequencias);
+        fechar_entrada(&leitor, &mapa);
+        fclose(in);
+    }
+
+    Codigo tabela[256];
+    Escritor memoria;
+    if (!calcular_codigos(frequencias, tabela, 0) || !abrir_escritor_memoria(&memoria, TAMANHO_MAXIMO_CABECALHO + 4))
+        return 0;
+    escrever_marcador(&memoria, MARCADOR_DICIONARIO);
+    escrever_cabecalho_bloco(&memoria, tabela, 0);
+
+    FILE *out = fopen(saida, "wb");
+    int ok = out && !memoria.erro && fwrite(memoria.dados, sizeof(BYTE), memoria.pos, out) == memoria.pos;
+    if (out && fclose(out) != 0)
+        ok = 0;
+    free(memoria.dados);
+    return ok;
+}
+
+int carregar_dicionario(const char *arquivo, Dicionario *d)
+{
+    BYTE dados[TAMANHO_MAXIMO_CABECALHO + 4];
+    FILE *in = fopen(arquivo, "rb");
+    if (!in)
+        return 0;
+    size_t lidos = fread(dados, sizeof(BYTE), sizeof(dados), in);
+    fclose(in);
+
+    int trash_bits;
+    if (lidos < 4 || dados[0] != MARCADOR_0 || dados[1] != MARCADOR_1 || dados[2] != MARCADOR_2 ||
+        dados[3] != MARCADOR_DICIONARIO)
+        return 0;
+    memset(d->tabela, 0, sizeof(d->tabela));
+    size_t usados = ler_cabecalho_bloco(dados + 4, lidos - 4, d->tabela, &trash_bits);
+    if (!usados)
+        return 0;
+    d->identificador = identificar_dicionario(dados + 4, usados);
+    return montar_tabela_decodificacao(&d->td, d->tabela, NULL, SEM_NO);
+}
+
+// Compacta com a tabela do dicionário; o arquivo inteiro é montado em
+// memória e gravado com um só fwrite
+int compactar_com_dicionario(const Dicionario *d, const char *entrada, const char *saida)
+{
+    FILE *in = fopen(entrada, "rb");
+    Leitor leitor;
+    Mapeamento mapa;
+    Escritor memoria;
+    if (!in)
+        return 0;
+    if (!abrir_entrada(&leitor, in, &mapa))
+    {
+        fclose(in);
+        return 0;
+    }
+    if (!abrir_escritor_memoria(&memoria, mapa.tamanho + TAMANHO_CABECALHO_DICIONARIO + 8))
+    {
+        fechar_entrada(&leitor, &mapa);
+        fclose(in);
+        return 0;
+    }
+
+    escrever_marcador(&memoria, VERSAO_DICIONARIO);
+    escrever_inteiro(&memoria, d->identificador, 4);
+    escrever_byte(&memoria, 0);
+    escrever_inteiro(&memoria, 0, 4);
+
+    // Símbolos fora do dicionário ou dados que não diminuem vão crus
+    uint64_t frequencias[256] = {0}, original = 0, bits_total = 0;
+    int cru = 0;
+    contar_frequencias(&leitor, frequencias);
+    reiniciar_entrada(&leitor, &mapa);
+    for (int c = 0; c < 256; c++)
+    {
+        if (frequencias[c] && !d->tabela[c].bits)
+            cru = 1;
+        original += frequencias[c];
+        bits_total += frequencias[c] * d->tabela[c].bits;
+    }
+    cru = cru || (bits_total + 7) / 8 >= original;
+
+    int ok = 1, lixo = FLAG_CRU;
+    uint32_t crc = 0;
+    if (cru)
+    {
+        while (recarregar_leitor(&leitor))
+        {
+            crc = atualizar_crc32c(crc, leitor.dados, leitor.tamanho);
+            escrever_bytes(&memoria, leitor.dados, leitor.tamanho);
+        }
+    }
+    else
+    {
+        EscritorBits bits;
+        iniciar_escritor_bits(&bits, &memoria);
+        while (ok && recarregar_leitor(&leitor))
+        {
+            crc = atualizar_crc32c(crc, leitor.dados, leitor.tamanho);
+            for (size_t k = 0; k < leitor.tamanho; k++)
+            {
+                const Codigo *cod = &d->tabela[leitor.dados[k]];
+                if (!cod->bits)
+                {
+                    ok = 0;
+                    break;
+                }
+                escrever_bits(&bits, cod->codigo, cod->bits);
+            }
+        }
+        lixo = finalizar_escritor_bits(&bits);
+    }
+    fechar_entrada(&leitor, &mapa);
+    fclose(in);
+
+    ok = ok && !memoria.erro;
+    if (ok)
+    {
+        memoria.dados[8] = (BYTE) (lixo | FLAG_CRC32C);
+        guardar_inteiro(memoria.dados + 9, crc, 4);
+        FILE *out = fopen(saida, "wb");
+        ok = out && fwrite(memoria.dados, sizeof(BYTE), memoria.pos, out) == memoria.pos;
+        if (out && fclose(out) != 0)
+            ok = 0;
+    }
+    free(memoria.dados);
+    return ok;
+}
+
+// Ordem 1: cada byte é codificado com a tabela do byte anterior (o primeiro
+// usa o contexto 0). Depois do marcador vêm os bits de lixo(1), o CRC32C
+// dos dados originais(4) se o byte de lixo tiver FLAG_CRC32C, um mapa de
+// 32 bytes com os contextos usados e o cabeçalho de bloco de cada contexto
+// usado, em ordem (o byte de lixo desses cabeçalhos fica 0)
+
+#define VERSAO_CONTEXTO 4
+
+int contexto_usado(const BYTE *mapa_contextos, int c)
+{
+    return (mapa_contextos[c >> 3] >> (c & 7)) & 1;
+}
+
+// Retorna 0, sem gravar nada, quando a ordem 0 sairia menor (as tabelas
+// de contexto não se pagam em dados aleatórios ou arquivos pequenos)
+int compactar_contexto(const char *entrada, const char *saida)
+{
+    FILE *in = fopen(entrada, "rb");
+    if (!in)
+    {
+        printf("Erro ao abrir arquivo de entrada\n");
+        return 1;
+    }
+
+    Leitor leitor;
+    Mapeamento mapa;
+    uint64_t (*frequencias)[256] = (uint64_t (*)[256]) calloc(256, sizeof(*frequencias));
+    Codigo (*tabelas)[256] = (Codigo (*)[256]) calloc(256, sizeof(*tabelas));
+    if (!frequencias || !tabelas || !abrir_entrada(&leitor, in, &mapa))
+    {
+        printf("Erro ao alocar as tabelas de contexto\n");
+        free(frequencias);
+        free(tabelas);
+        fclose(in);
+        return 1;
+    }
+
+    BYTE anterior = 0;
+    uint32_t crc = 0;
+    while (recarregar_leitor(&leitor))
+    {
+        crc = atualizar_crc32c(crc, leitor.dados, leitor.tamanho);
+        for (size_t k = 0; k < leitor.tamanho; k++)
+        {
+            frequencias[anterior][leitor.dados[k]]++;
+            anterior = leitor.dados[k];
+        }
+    }
+    reiniciar_entrada(&leitor, &mapa);
+
+    // Tabelas dos contextos usados, já serializadas, e o custo em bits de
+    // cada ordem, cabeçalhos incluídos
+    BYTE mapa_contextos[32] = {0};
+    uint64_t soma[256] = {0};
+    Codigo tabela_ordem0[256];
+    Escritor cabecalhos;
+    int ok = abrir_escritor_memoria(&cabecalhos, 4096);
+    uint64_t bits_ordem1 = 0;
+    for (int c = 0; ok && c < 256; c++)
+    {
+        int usado = 0;
+        for (int s = 0; s < 256; s++)
+        {
+            usado |= frequencias[c][s] != 0;
+            soma[s] += frequencias[c][s];
+        }
+        if (!usado)
+            continue;
+        mapa_contextos[c >> 3] |= (BYTE) (1 << (c & 7));
+        ok = calcular_codigos(frequencias[c], tabelas[c], 0);
+        escrever_cabecalho_bloco(&cabecalhos, tabelas[c], 0);
+        bits_ordem1 += bits_codificados(frequencias[c], tabelas[c]);
+    }
+    free(frequencias);
+    bits_ordem1 += 8 * (1 + 4 + sizeof(mapa_contextos) + (uint64_t) cabecalhos.pos);
+    ok = ok && !cabecalhos.erro && calcular_codigos(soma, tabela_ordem0, 0);
+
+    if (ok)
+    {
+        Escritor cabecalho_ordem0;
+        uint64_t bits_ordem0 = bits_codificados(soma, tabela_ordem0);
+        if (abrir_escritor_memoria(&cabecalho_ordem0, TAMANHO_MAXIMO_CABECALHO))
+        {
+            escrever_cabecalho_bloco(&cabecalho_ordem0, tabela_ordem0, 0);
+            bits_ordem0 += 8 * (uint64_t) cabecalho_ordem0.pos;
+            free(cabecalho_ordem0.dados);
+        }
+        if (bits_ordem0 <= bits_ordem1)
+        {
+            fechar_entrada(&leitor, &mapa);
+            free(cabecalhos.dados);
+            free(tabelas);
+            fclose(in);
+            return 0;
+        }
+    }
+
+    FILE *out = ok ? fopen(saida, "wb") : NULL;
+    Escritor escritor;
+    if (!out || !abrir_escritor(&escritor, out))
+    {
+        printf(ok ? "Erro ao abrir arquivo de saída\n" : "Erro ao calcular os códigos\n");
+        fechar_entrada(&leitor, &mapa);
+        free(cabecalhos.dados);
+        free(tabelas);
+        fclose(in);
+        if (out) fclose(out);
+        return 1;
+    }
+
+    escrever_marcador(&escritor, VERSAO_CONTEXTO);
+    escrever_byte(&escritor, 0);
+    escrever_inteiro(&escritor, crc, 4);
+    escrever_bytes(&escritor, mapa_contextos, sizeof(mapa_contextos));
+    escrever_bytes(&escritor, cabecalhos.dados, cabecalhos.pos);
+    free(cabecalhos.dados);
+
+    EscritorBits bits;
+    iniciar_escritor_bits(&bits, &escritor);
+    anterior = 0;
+    while (recarregar_leitor(&leitor))
+    {
+        for (size_t k = 0; k < leitor.tamanho; k++)
+        {
+            Codigo *cod = &tabelas[anterior][leitor.dados[k]];
+            escrever_bits(&bits, cod->codigo, cod->bits);
+            anterior = leitor.dados[k];
+        }
+    }
+
+    BYTE trash_bits = (BYTE) (finalizar_escritor_bits(&bits) | FLAG_CRC32C);
+    fechar_escritor(&escritor);
+    ok = !escritor.erro && fseek(out, 4, SEEK_SET) == 0 &&
+         fwrite(&trash_bits, sizeof(BYTE), 1, out) == 1;
+
+    fechar_entrada(&leitor, &mapa);
+    free(tabelas);
+    fclose(in);
+    if (fclose(out) != 0)
+        ok = 0;
+    if (!ok)
+    {
+        printf("Erro ao gravar o arquivo compactado\n");
+        remove(saida);
+        return 1;
+    }
+    printf("Arquivo compactado com sucesso (ordem 1)!\n");
+    return 1;
+}
+
+// Lê as tabelas de contexto (a posição deve estar logo após o marcador) e
+// decodifica o resto de "in" para "out"; se o CRC32C foi gravado, liga
+// "conferir_crc" em "out" e confere o resultado
+int descompactar_contexto(FILE *in, Escritor *out)
+{
+    BYTE inicio[33], crc[4];
+    if (fread(inicio, sizeof(BYTE), 1, in) != 1 ||
+        ((inicio[0] & FLAG_CRC32C) && fread(crc, sizeof(BYTE), 4, in) != 4) ||
+        fread(inicio + 1, sizeof(BYTE), 32, in) != 32)
+        return 0;
+    int trash_bits = inicio[0] & 7;
+    const BYTE *mapa_contextos = inicio + 1;
+    out->conferir_crc = (inicio[0] & FLAG_CRC32C) != 0;
+
+    TabelaDecodificacao *tds = (TabelaDecodificacao *) calloc(256, sizeof(TabelaDecodificacao));
+    if (!tds)
+        return 0;
+
+    int ok = 1;
+    for (int c = 0; ok && c < 256; c++)
+    {
+        if (!contexto_usado(mapa_contextos, c))
+            continue;
+        Codigo tabela[256] = {0};
+        int lixo;
+        ok = ler_cabecalho_arquivo(in, tabela, &lixo, NULL) && montar_tabela_decodificacao(&tds[c], tabela, NULL, SEM_NO);
+    }
+
+    Leitor leitor;
+    Mapeamento mapa;
+    if (ok && abrir_entrada(&leitor, in, &mapa))
+    {
+        long inicio_dados = ftell(in);
+        fseek(in, 0, SEEK_END);
+        long tamanho_total = ftell(in) - inicio_dados;
+        fseek(in, inicio_dados, SEEK_SET);
+        if (mapa.dados)
+            abrir_leitor_memoria(&leitor, mapa.dados + inicio_dados, (size_t) tamanho_total);
+
+        LeitorBits lb;
+        uint64_t total_bits = tamanho_total > 0 ? (uint64_t) tamanho_total * 8 - trash_bits : 0;
+        iniciar_leitor_bits(&lb, &leitor, total_bits);
+
+        int anterior = 0;
+        while (!out->erro)
+        {
+            // Contexto sem tabela só pode vir depois do último byte
+            if (!contexto_usado(mapa_contextos, anterior))
+            {
+                recarregar_bits(&lb);
+                ok = lb.bits == 0;
+                break;
+            }
+            int simbolo = decodificar_simbolo(&tds[anterior], &lb);
+            if (simbolo < 0)
+            {
+                ok = simbolo == FIM_DOS_DADOS;
+                break;
+            }
+            escrever_byte(out, (BYTE) simbolo);
+            anterior = simbolo;
+        }
+        ok = ok && !out->erro && (!out->conferir_crc || crc_confere(out, (uint32_t) ler_inteiro(crc, 4)));
+        fechar_entrada(&leitor, &mapa);
+    }
+    else
+        ok = 0;
+
+    for (int c = 0; c < 256; c++)
+        liberar_tabela_decodificacao(&tds[c]);
+    free(tds);
+    return ok;
+}
+
+// Codifica toda a entrada, passando pela RLE se "trecho" não for NULL;
+// acumula o CRC32C da entrada e retorna os bits de lixo
+int codificar_arquivo(Leitor *leitor, Codigo *tabela, BYTE *trecho, Escritor *out, uint32_t *crc)
+{
+    EscritorBits bits;
+    iniciar_escritor_bits(&bits, out);
+    if (trecho)
+    {
+        EstadoRLE rle;
+        size_t m;
+        iniciar_rle(&rle);
+        while ((m = ler_trecho_rle(leitor, &rle, trecho, crc)) > 0)
+        {
+            for (size_t k = 0; k < m; k++)
+            {
+                Codigo *cod = &tabela[trecho[k]];
+                escrever_bits(&bits, cod->codigo, cod->bits);
+            }
+        }
+    }
+    else
+    {
+        size_t n;
+        while ((n = recarregar_leitor(leitor)) > 0)
+        {
+            const BYTE *dados = leitor->dados;
+            *crc = atualizar_crc32c(*crc, dados, n);
+            for (size_t k = 0; k < n; k++)
+            {
+                Codigo *cod = &tabela[dados[k]];
+                escrever_bits(&bits, cod->codigo, cod->bits);
+            }
+        }
+    }
+    return finalizar_escritor_bits(&bits);
+}
+
+// Os próximos "tamanho" bytes do leitor inteiros na memória, para os fluxos
+// intercalados: os do próprio leitor, se ele já for em memória (mmap), ou
+// uma cópia em "copia" (NULL se faltar memória)
+const BYTE *entrada_em_memoria(Leitor *leitor, uint64_t tamanho, BYTE **copia)
+{
+    if (!leitor->arquivo)
+        return leitor->dados;
+
+    *copia = (BYTE *) calloc(tamanho ? (size_t) tamanho : 1, sizeof(BYTE));
+    uint64_t lidos = 0;
+    while (*copia && lidos < tamanho && recarregar_leitor(leitor))
+    {
+        size_t n = leitor->tamanho < tamanho - lidos ? leitor->tamanho : (size_t) (tamanho - lidos);
+        memcpy(*copia + lidos, leitor->dados, n);
+        lidos += n;
+    }
+    return *copia;
+}
+
+void compactar_arquivo(const char *entrada, const char *saida)
+{
+    if (dicionario)
+    {
+        if (compactar_com_dicionario(dicionario, entrada, saida))
+            printf("Arquivo compactado com sucesso!\n");
+        else
+            printf("Erro ao compactar %s com o dicionário\n", entrada);
+        return;
+    }
+
+    if (usar_contexto && compactar_contexto(entrada, saida))
+        return;
+
+    if (usar_adaptativo)
+    {
+        FILE *in = fopen(entrada, "rb");
+        FILE *out = in ? fopen(saida, "wb") : NULL;
+        int ok = out && compactar_adaptativo(in, out);
+        if (in) fclose(in);
+        if (out) fclose(out);
+        printf(ok ? "Arquivo compactado com sucesso!\n" : "Erro ao compactar no modo adaptativo\n");
+        return;
+    }
+
+    if (tamanho_bloco_conteiner)
+    {
+        compactar_em_blocos(entrada, saida);
+        return;
+    }
+
+    FILE *in = fopen(entrada, "rb");
+    if (!in)
+    {
+        printf("Erro ao abrir arquivo de entrada\n");
+        return;
+    }
+
+    Leitor leitor;
+    Mapeamento mapa;
+    if (!abrir_entrada(&leitor, in, &mapa))
+    {
+        printf("Erro ao alocar buffer de leitura\n");
+        fclose(in);
+        return;
+    }
+
+    uint64_t frequencias[256] = {0};
+    contar_frequencias(&leitor, frequencias);
+    reiniciar_entrada(&leitor, &mapa);
+
+    Codigo tabela[256];
+    if (!calcular_codigos(frequencias, tabela, 1))
+    {
+        printf("Erro ao calcular os códigos\n");
+        fechar_entrada(&leitor, &mapa);
+        fclose(in);
+        return;
+    }
+
+    // Com -r, uma passada a mais conta os dados transformados pela RLE
+    int flags = 0;
+    uint64_t frequencias_rle[256] = {0};
+    BYTE *trecho = usar_rle ? (BYTE *) malloc(tamanho_bloco_io + tamanho_bloco_io / 4 + 1) : NULL;
+    if (trecho)
+    {
+        EstadoRLE rle;
+        size_t m;
+        iniciar_rle(&rle);
+        while ((m = ler_trecho_rle(&leitor, &rle, trecho, NULL)) > 0)
+            contar_frequencias_bloco(trecho, m, frequencias_rle);
+        reiniciar_entrada(&leitor, &mapa);
+        flags = escolher_rle(frequencias, tabela, frequencias_rle);
+    }
+
+    FILE *out = fopen(saida, "wb");
+    Escritor escritor;
+    if (!out || !abrir_escritor(&escritor, out))
+    {
+        printf("Erro ao abrir arquivo de saída\n");
+        fechar_entrada(&leitor, &mapa);
+        free(trecho);
+        fclose(in);
+        if (out) fclose(out);
+        return;
+    }
+
+    // Os campos do cabeçalho estendido são reescritos no final
+    CabecalhoEstendido cabecalho = { ESTENDIDO_CRC32C, 0, 0, 1, 0 };
+    BYTE campos[TAMANHO_CABECALHO_ESTENDIDO + 1];
+    montar_cabecalho_estendido(campos, &cabecalho);
+    escrever_marcador(&escritor, VERSAO_ESTENDIDA);
+    escrever_bytes(&escritor, campos, TAMANHO_CABECALHO_ESTENDIDO);
+
+    for (int c = 0; c < 256; c++)
+        cabecalho.original += frequencias[c];
+
+    // Se a compactação não reduziria o arquivo, ele é guardado como está
+    uint64_t estimado = tamanho_estimado(flags ? frequencias_rle : frequencias, tabela);
+    int cru = estimado >= cabecalho.original;
+    if (cru)
+    {
+        escrever_byte(&escritor, FLAG_CRU);
+        while (recarregar_leitor(&leitor))
+        {
+            cabecalho.crc = atualizar_crc32c(cabecalho.crc, leitor.dados, leitor.tamanho);
+            escrever_bytes(&escritor, leitor.dados, leitor.tamanho);
+        }
+        campos[TAMANHO_CABECALHO_ESTENDIDO] = FLAG_CRU;
+    }
+    else
+    {
+        escrever_cabecalho_bloco(&escritor, tabela, 0);
+        int trash_bits = codificar_arquivo(&leitor, tabela, flags ? trecho : NULL, &escritor, &cabecalho.crc);
+        campos[TAMANHO_CABECALHO_ESTENDIDO] = (BYTE) (trash_bits | flags);
+    }
+
+    cabecalho.compactado = bytes_escritos(&escritor) - 4 - TAMANHO_CABECALHO_ESTENDIDO;
+    fechar_escritor(&escritor);
+    if (escritor.erro)
+        printf("Erro ao gravar o arquivo compactado\n");
+    montar_cabecalho_estendido(campos, &cabecalho);
+    fseek(out, 4, SEEK_SET);
+    fwrite(campos, sizeof(BYTE), sizeof(campos), out);
+
+    fechar_entrada(&leitor, &mapa);
+    free(trecho);
+    fclose(in);
+    fclose(out);
+    printf(cru ? "Arquivo guardado sem compactação (os dados não diminuiriam)\n" : "Arquivo compactado com sucesso!\n");
+}
+
+// Resultado da conferência feita durante a descompactação
+#define INTEGRIDADE_ERRO (-1)
+#define INTEGRIDADE_AUSENTE 0
+#define INTEGRIDADE_OK 1
+
+// Depois de fechado o escritor: confere o tamanho e o CRC32C gravados no
+// cabeçalho estendido; se faltaram bytes, desfaz a reserva feita com ftruncate
+int conferir_saida(FILE *out, Escritor *escritor, const CabecalhoEstendido *estendido)
+{
+    if (escritor->descarregados != estendido->original)
+    {
+        fflush(out);
+        if (ftruncate(fileno(out), (off_t) escritor->descarregados) != 0)
+            perror("Aviso: não foi possível ajustar o arquivo de saída");
+        return INTEGRIDADE_ERRO;
+    }
+    if (!(estendido->flags & ESTENDIDO_CRC32C))
+        return INTEGRIDADE_AUSENTE;
+    if (escritor->crc != estendido->crc)
+    {
+        printf("Aviso: o CRC32C não confere (%08x, esperado %08x)\n", escritor->crc, estendido->crc);
+        return INTEGRIDADE_ERRO;
+    }
+    return INTEGRIDADE_OK;
+}
+
+// Retorna INTEGRIDADE_OK quando o CRC32C gravado conferiu, INTEGRIDADE_AUSENTE
+// quando o formato não tem CRC e INTEGRIDADE_ERRO em qualquer falha
+int descompactar_arquivo(const char *entrada, const char *saida)
+{
+    FILE *in = fopen(entrada, "rb");
+    if (!in)
+    {
+        printf("Erro ao abrir arquivo de entrada\n");
+        return INTEGRIDADE_ERRO;
+    }
+
+    int trash_bits, flags = 0;
+    uint32_t crc_dicionario = 0;
+    Codigo tabela[256] = {0};
+    Arena arena;
+    int raiz = SEM_NO;
+    CabecalhoEstendido estendido;
+    int versao = ler_marcador(in);
+    if (eh_conteiner(versao))
+    {
+        FILE *out = fopen(saida, "wb");
+        Escritor escritor;
+        if (!out || !abrir_escritor(&escritor, out))
+        {
+            printf("Erro ao abrir arquivo de saída\n");
+            fclose(in);
+            if (out) fclose(out);
+            return INTEGRIDADE_ERRO;
+        }
+        int ok = num_threads > 1 ? descompactar_blocos_paralelo(in, versao, entrada, out)
+                                 : descompactar_blocos(in, versao, &escritor);
+        fechar_escritor(&escritor);
+        fclose(in);
+        fclose(out);
+        printf(ok ? "Arquivo descompactado com sucesso!\n" : "Aviso: dados compactados corrompidos\n");
+        if (!ok)
+            return INTEGRIDADE_ERRO;
+        return versao == VERSAO_BLOCOS_CRC ? INTEGRIDADE_OK : INTEGRIDADE_AUSENTE;
+    }
+    else if (versao == VERSAO_CONTEXTO || versao == VERSAO_ADAPTATIVA)
+    {
+        FILE *out = fopen(saida, "wb");
+        Escritor escritor;
+        if (!out || !abrir_escritor(&escritor, out))
+        {
+            printf("Erro ao abrir arquivo de saída\n");
+            fclose(in);
+            if (out) fclose(out);
+            return INTEGRIDADE_ERRO;
+        }
+        int ok = versao == VERSAO_CONTEXTO ? descompactar_contexto(in, &escritor)
+                                           : descompactar_adaptativo(in, &escritor);
+        fechar_escritor(&escritor);
+        fclose(in);
+        fclose(out);
+        printf(ok ? "Arquivo descompactado com sucesso!\n" : "Aviso: dados compactados corrompidos\n");
+        if (!ok)
+            return INTEGRIDADE_ERRO;
+        return escritor.conferir_crc ? INTEGRIDADE_OK : INTEGRIDADE_AUSENTE;
+    }
+    else if (versao == VERSAO_CANONICA || versao == VERSAO_ESTENDIDA)
+    {
+        if ((versao == VERSAO_ESTENDIDA && !ler_cabecalho_estendido(in, &estendido)) ||
+            !ler_cabecalho_arquivo(in, tabela, &trash_bits, &flags))
+        {
+            printf("Cabeçalho inválido\n");
+            fclose(in);
+            return INTEGRIDADE_ERRO;
+        }
+    }
+    else if (versao == VERSAO_DICIONARIO)
+    {
+        BYTE campo[9];
+        if (!dicionario || fread(campo, sizeof(BYTE), 5, in) != 5 ||
+            ler_inteiro(campo, 4) != dicionario->identificador)
+        {
+            printf("Arquivo compactado com dicionário: informe o mesmo dicionário com -D\n");
+            fclose(in);
+            return INTEGRIDADE_ERRO;
+        }
+        if ((campo[4] & FLAG_CRC32C) && fread(campo + 5, sizeof(BYTE), 4, in) != 4)
+        {
+            printf("Cabeçalho inválido\n");
+            fclose(in);
+            return INTEGRIDADE_ERRO;
+        }
+        trash_bits = campo[4] & 7;
+        flags = campo[4] & (FLAG_CRU | FLAG_CRC32C);
+        crc_dicionario = (uint32_t) ler_inteiro(campo + 5, 4);
+    }
+    else if (versao)
+    {
+        printf("Versão de formato desconhecida: %d\n", versao);
+        fclose(in);
+        return INTEGRIDADE_ERRO;
+    }
+    else
+    {
+        // Formato antigo: header de 2 bytes e árvore em pré-ordem
+        unsigned short tree_size;
+        ler_header(in, &trash_bits, &tree_size);
+
+        int pos = tree_size;
+        iniciar_arena(&arena);
+        raiz = reconstruir_arvore(&arena, in, &pos);
+        if (raiz == SEM_NO)
+        {
+            printf("Cabeçalho inválido\n");
+            fclose(in);
+            return INTEGRIDADE_ERRO;
+        }
+        gerar_codigos(&arena, raiz, tabela, 0, 0);
+    }
+
+    FILE *out = fopen(saida, "wb");
+    Leitor leitor;
+    Mapeamento mapa;
+    Escritor escritor;
+    if (!out || !abrir_entrada(&leitor, in, &mapa) || !abrir_escritor(&escritor, out))
+    {
+        printf("Erro ao preparar a descompactação\n");
+        fclose(in);
+        if (out) fclose(out);
+        return INTEGRIDADE_ERRO;
+    }
+
+    // No cabeçalho estendido, o tamanho dos dados já vem gravado e a
+    // saída é alocada de uma vez
+    long total_bytes = ftell(in);
+    long tamanho_total;
+    if (versao == VERSAO_ESTENDIDA)
+    {
+        long cabecalho_bloco = total_bytes - 4 - TAMANHO_CABECALHO_ESTENDIDO;
+        tamanho_total = (long) estendido.compactado - cabecalho_bloco;
+        escritor.conferir_crc = (estendido.flags & ESTENDIDO_CRC32C) != 0;
+        if (estendido.original && ftruncate(fileno(out), (off_t) estendido.original) != 0)
+            perror("Aviso: não foi possível reservar o arquivo de saída");
+    }
+    else
+    {
+        fseek(in, 0, SEEK_END);
+        tamanho_total = ftell(in) - total_bytes;
+        fseek(in, total_bytes, SEEK_SET);
+        escritor.conferir_crc = (flags & FLAG_CRC32C) != 0;
+    }
+    if (mapa.dados)
+    {
+        if (tamanho_total < 0 || (uint64_t) (total_bytes + tamanho_total) > (uint64_t) mapa.tamanho)
+            tamanho_total = (long) mapa.tamanho - total_bytes;
+        abrir_leitor_memoria(&leitor, mapa.dados + total_bytes, (size_t) tamanho_total);
+    }
+    else if (tamanho_total < 0)
+        tamanho_total = 0;
+
+    if (flags & FLAG_CRU)
+    {
+        uint64_t restantes = (uint64_t) tamanho_total;
+        while (restantes && recarregar_leitor(&leitor))
+        {
+            size_t n = leitor.tamanho < restantes ? leitor.tamanho : (size_t) restantes;
+            escrever_bytes(&escritor, leitor.dados, n);
+            restantes -= n;
+        }
+        fechar_escritor(&escritor);
+        int resultado = versao == VERSAO_ESTENDIDA ? conferir_saida(out, &escritor, &estendido) : INTEGRIDADE_AUSENTE;
+        if (versao == VERSAO_DICIONARIO && escritor.conferir_crc)
+            resultado = crc_confere(&escritor, crc_dicionario) ? INTEGRIDADE_OK : INTEGRIDADE_ERRO;
+        fechar_entrada(&leitor, &mapa);
+        fclose(in);
+        fclose(out);
+        printf(resultado != INTEGRIDADE_ERRO ? "Arquivo descompactado com sucesso!\n" : "Aviso: dados compactados corrompidos\n");
+        return resultado;
+    }
+
+    // Com dicionário, a tabela de decodificação já está pronta
+    TabelaDecodificacao td;
+    TabelaDecodificacao *decodificador = versao == VERSAO_DICIONARIO ? &dicionario->td : &td;
+    if (decodificador == &td && !montar_tabela_decodificacao(&td, tabela, &arena, raiz))
+    {
+        printf("Erro ao montar a tabela de decodificação\n");
+        fechar_escritor(&escritor);
+        fechar_entrada(&leitor, &mapa);
+        fclose(in);
+        fclose(out);
+        return INTEGRIDADE_ERRO;
+    }
+
+    LeitorBits lb;
+    uint64_t total_bits = tamanho_total > 0 ? (uint64_t) tamanho_total * 8 - trash_bits : 0;
+    iniciar_leitor_bits(&lb, &leitor, total_bits);
+    int ok;
+    if (flags & FLAG_INTERCALADO)
+    {
+        BYTE *copia = NULL;
+        const BYTE *fluxos = entrada_em_memoria(&leitor, (uint64_t) tamanho_total, &copia);
+        ok = fluxos && decodificar_intercalado(decodificador, fluxos, (size_t) tamanho_total, &escritor);
+        free(copia);
+    }
+    else if (flags & FLAG_RLE)
+        ok = decodificar_rle(decodificador, &lb, &escritor);
+    else
+        ok = decodificar_com_tabela(decodificador, &lb, &escritor);
+    if (decodificador == &td)
+        liberar_tabela_decodificacao(&td);
+
+    fechar_escritor(&escritor);
+    int resultado = versao == VERSAO_ESTENDIDA ? conferir_saida(out, &escritor, &estendido) : INTEGRIDADE_AUSENTE;
+    if (versao == VERSAO_DICIONARIO && escritor.conferir_crc)
+        resultado = crc_confere(&escritor, crc_dicionario) ? INTEGRIDADE_OK : INTEGRIDADE_ERRO;
+    if (!ok)
+        resultado = INTEGRIDADE_ERRO;
+    fechar_entrada(&leitor, &mapa);
+    fclose(in);
+    fclose(out);
+    printf(resultado != INTEGRIDADE_ERRO ? "Arquivo descompactado com sucesso!\n" : "Aviso: dados compactados corrompidos\n");
+    return resultado;
+}
+
+// Função nova: Verificar header
+void verificar_header(const char *arquivo)
+{
+    FILE *in = fopen(arquivo, "rb");
+    if (!in)
+    {
+        perror("Erro ao abrir arquivo");
+        return;
+    }
+
+    int trash_bits;
+    printf("Header do arquivo %s:\n", arquivo);
+    int versao = ler_marcador(in);
+    if (eh_conteiner(versao))
+    {
+        BYTE campo[4];
+        uint64_t original, blocos, pos_indice;
+        if (fread(campo, sizeof(BYTE), 4, in) != 4 || !ler_rodape(in, &original, &blocos, &pos_indice))
+        {
+            printf("- Cabeçalho inválido\n");
+            fclose(in);
+            return;
+        }
+        printf("- Formato: blocos independentes (versão %d%s)\n", versao,
+               versao == VERSAO_BLOCOS_CRC ? ", com CRC32C por bloco" : "");
+        printf("- Tamanho do bloco: %llu bytes\n", (unsigned long long) ler_inteiro(campo, 4));
+        printf("- Blocos: %llu\n", (unsigned long long) blocos);
+        printf("- Tamanho original: %llu bytes\n", (unsigned long long) original);
+    }
+    else if (versao == VERSAO_CONTEXTO)
+    {
+        BYTE inicio[33], crc[4];
+        int contextos = 0, valido = fread(inicio, sizeof(BYTE), 1, in) == 1 &&
+                                    (!(inicio[0] & FLAG_CRC32C) || fread(crc, sizeof(BYTE), 4, in) == 4) &&
+                                    fread(inicio + 1, sizeof(BYTE), 32, in) == 32;
+        for (int c = 0; valido && c < 256; c++)
+        {
+            Codigo tabela[256] = {0};
+            if (contexto_usado(inicio + 1, c))
+            {
+                valido = ler_cabecalho_arquivo(in, tabela, &trash_bits, NULL);
+                contextos++;
+            }
+        }
+        if (!valido)
+        {
+            printf("- Cabeçalho inválido\n");
+            fclose(in);
+            return;
+        }
+        printf("- Formato: ordem 1, uma tabela por byte anterior (versão %d)\n", VERSAO_CONTEXTO);
+        printf("- Bits de lixo: %d\n", inicio[0] & 7);
+        if (inicio[0] & FLAG_CRC32C)
+            printf("- CRC32C: %08llx\n", (unsigned long long) ler_inteiro(crc, 4));
+        printf("- Contextos com tabela: %d\n", contextos);
+        printf("- Tamanho do cabeçalho: %ld bytes\n", ftell(in));
+    }
+    else if (versao == VERSAO_ADAPTATIVA)
+    {
+        printf("- Formato: Huffman adaptativo, sem tabela gravada (versão %d)\n", VERSAO_ADAPTATIVA);
+        printf("- Tamanho do cabeçalho: 4 bytes (o CRC32C fica no final)\n");
+    }
+    else if (versao == VERSAO_DICIONARIO)
+    {
+        BYTE campo[9];
+        if (fread(campo, sizeof(BYTE), 5, in) != 5 ||
+            ((campo[4] & FLAG_CRC32C) && fread(campo + 5, sizeof(BYTE), 4, in) != 4))
+        {
+            printf("- Cabeçalho inválido\n");
+            fclose(in);
+            return;
+        }
+        printf("- Formato: códigos de um dicionário externo (versão %d)\n", VERSAO_DICIONARIO);
+        printf("- Dicionário: %08llx\n", (unsigned long long) ler_inteiro(campo, 4));
+        if (campo[4] & FLAG_CRU)
+            printf("- Dados guardados sem compactação\n");
+        else
+            printf("- Bits de lixo: %d\n", campo[4] & 7);
+        if (campo[4] & FLAG_CRC32C)
+            printf("- CRC32C: %08llx\n", (unsigned long long) ler_inteiro(campo + 5, 4));
+        printf("- Tamanho do cabeçalho: %ld bytes\n", ftell(in));
+    }
+    else if (versao)
+    {
+        Codigo tabela[256] = {0};
+        int flags;
+        CabecalhoEstendido estendido;
+        int valido = versao == VERSAO_CANONICA ||
+                     (versao == VERSAO_ESTENDIDA && ler_cabecalho_estendido(in, &estendido));
+        if (!valido || !ler_cabecalho_arquivo(in, tabela, &trash_bits, &flags))
+        {
+            printf("- Cabeçalho inválido\n");
+            fclose(in);
+            return;
+        }
+
+        int simbolos = 0, max_bits = 0;
+        for (int c = 0; c < 256; c++)
+        {
+            if (tabela[c].bits)
+                simbolos++;
+            if (tabela[c].bits > max_bits)
+                max_bits = tabela[c].bits;
+        }
+        if (versao == VERSAO_ESTENDIDA)
+        {
+            printf("- Formato: códigos canônicos com cabeçalho estendido (versão %d)\n", VERSAO_ESTENDIDA);
+            printf("- Flags: 0x%04x\n", estendido.flags);
+            printf("- Tamanho original: %llu bytes\n", (unsigned long long) estendido.original);
+            printf("- Tamanho compactado: %llu bytes\n", (unsigned long long) estendido.compactado);
+            printf("- Blocos: %u\n", estendido.blocos);
+            if (estendido.flags & ESTENDIDO_CRC32C)
+                printf("- CRC32C: %08x\n", estendido.crc);
+        }
+        else
+            printf("- Formato: códigos canônicos (versão %d)\n", VERSAO_CANONICA);
+        if (flags & FLAG_CRU)
+        {
+            printf("- Dados guardados sem compactação\n");
+            fclose(in);
+            return;
+        }
+        printf("- Bits de lixo: %d\n", trash_bits);
+        printf("- Pré-passada RLE: %s\n", (flags & FLAG_RLE) ? "sim" : "não");
+        printf("- Fluxos intercalados: %s\n", (flags & FLAG_INTERCALADO) ? "4" : "1");
+        printf("- Símbolos: %d\n", simbolos);
+        printf("- Maior código: %d bits\n", max_bits);
+        printf("- Tamanho do cabeçalho: %ld bytes\n", ftell(in));
+    }
+    else
+    {
+        unsigned short tree_size;
+        ler_header(in, &trash_bits, &tree_size);
 
-typedef struct Heap {
-    int tamanho;
-    No *dados[256];
-} Heap;
+        printf("- Formato: árvore em pré-ordem (antigo)\n");
+        printf("- Bits de lixo: %d\n", trash_bits);
+        printf("- Tamanho da árvore: %hu bytes\n", tree_size);
+    }
 
-typedef struct {
-    BYTE byte;
-    int frequencia;
-} Frequencia;
+    fclose(in);
+}
 
-typedef struct {
-    BYTE byte;
-    int frequencia;
-} Item;
+// Função nova: Verificar integridade
+// O CRC32C já foi conferido durante a descompactação, sem reler os arquivos
+void verificar_integridade(int resultado)
+{
+    if (resultado == INTEGRIDADE_OK)
+        printf("CRC32C conferido: os dados descompactados são idênticos aos originais!\n");
+    else if (resultado == INTEGRIDADE_AUSENTE)
+        printf("Este formato não guarda CRC32C; nada a conferir\n");
+    else
+        printf("Os dados descompactados não conferem com os originais\n");
+}
 
-// Funções da árvore de Huffman
+// Biblioteca (huff.h): buffers em memória no formato da versão 6, com um
+// único bloco. O bloco com FLAG_CRU limita o resultado a um byte a mais que
+// a entrada, além do marcador e do cabeçalho estendido
+
+#define TAMANHO_PREFIXO_ESTENDIDO (4 + TAMANHO_CABECALHO_ESTENDIDO)
 
-No* criar_no(BYTE caractere, int frequencia, No *esquerda, No *direita)
+size_t huff_compress_bound(size_t n)
 {
-    No *novo = (No *) malloc(sizeof(No));
-    novo->caractere = caractere;
-    novo->frequencia = frequencia;
-    novo->esquerda = esquerda;
-    novo->direita = direita;
-    return novo;
+    return TAMANHO_PREFIXO_ESTENDIDO + 1 + n;
 }
 
-int eh_folha(No *no)
+int huff_compress(const void *src, size_t n, void *dst, size_t *dst_len)
 {
-    return (no->esquerda == NULL && no->direita == NULL);
+    return huff_compress_ctx(NULL, src, n, dst, dst_len);
 }
 
-// Funções da heap
-
-Heap* criar_heap()
+int huff_compress_ctx(huff_ctx *ctx, const void *src, size_t n, void *dst, size_t *dst_len)
 {
-    Heap *heap = (Heap *) malloc(sizeof(Heap));
-    heap->tamanho = 0;
-    return heap;
+    if (*dst_len < TAMANHO_PREFIXO_ESTENDIDO + 1)
+        return HUFF_ERRO_DESTINO;
+
+    Escritor out;
+    abrir_escritor_fixo(&out, (BYTE *) dst, *dst_len);
+    escrever_marcador(&out, VERSAO_ESTENDIDA);
+    out.pos = TAMANHO_PREFIXO_ESTENDIDO;
+    if (!compactar_bloco(ctx, (const BYTE *) src, n, &out))
+        return out.erro ? HUFF_ERRO_DESTINO : HUFF_ERRO_MEMORIA;
+
+    CabecalhoEstendido cabecalho = { ESTENDIDO_CRC32C, n, out.pos - TAMANHO_PREFIXO_ESTENDIDO, 1,
+                                     atualizar_crc32c(0, (const BYTE *) src, n) };
+    montar_cabecalho_estendido((BYTE *) dst + 4, &cabecalho);
+    *dst_len = out.pos;
+    return HUFF_OK;
 }
 
-void trocar(No **a, No **b)
+int huff_decompressed_size(const void *src, size_t n, size_t *original)
 {
-    No *temp = *a;
-    *a = *b;
-    *b = temp;
+    const BYTE *dados = (const BYTE *) src;
+    CabecalhoEstendido cabecalho;
+    if (n < TAMANHO_PREFIXO_ESTENDIDO || dados[0] != MARCADOR_0 || dados[1] != MARCADOR_1 ||
+        dados[2] != MARCADOR_2 || dados[3] != VERSAO_ESTENDIDA ||
+        !interpretar_cabecalho_estendido(dados + 4, &cabecalho) ||
+        cabecalho.compactado != n - TAMANHO_PREFIXO_ESTENDIDO || cabecalho.original > SIZE_MAX)
+        return HUFF_ERRO_DADOS;
+    *original = (size_t) cabecalho.original;
+    return HUFF_OK;
 }
 
-void inserir_heap(Heap *heap, No *no)
+int huff_decompress(const void *src, size_t n, void *dst, size_t *dst_len)
 {
-    int i = heap->tamanho++;
-    heap->dados[i] = no;
-
-    while (i && heap->dados[i]->frequencia < heap->dados[(i - 1) / 2]->frequencia)
-    {
-        trocar(&heap->dados[i], &heap->dados[(i - 1) / 2]);
-        i = (i - 1) / 2;
-    }
+    return huff_decompress_ctx(NULL, src, n, dst, dst_len);
 }
 
-No* remover_min(Heap *heap)
+int huff_decompress_ctx(huff_ctx *ctx, const void *src, size_t n, void *dst, size_t *dst_len)
 {
-    No *minimo = heap->dados[0];
-    heap->dados[0] = heap->dados[--heap->tamanho];
+    size_t original;
+    if (huff_decompressed_size(src, n, &original) != HUFF_OK)
+        return HUFF_ERRO_DADOS;
+    size_t capacidade = *dst_len;
+    *dst_len = original;
+    if (capacidade < original)
+        return HUFF_ERRO_DESTINO;
 
-    int i = 0;
-    while (i * 2 + 1 < heap->tamanho)
-    {
-        int menor = i * 2 + 1;
-        if (menor + 1 < heap->tamanho && heap->dados[menor + 1]->frequencia < heap->dados[menor]->frequencia)
-            menor++;
+    // Sobra de 8 bytes para o escritor de bits, em um buffer próprio se o
+    // destino for pequeno demais para isso
+    const BYTE *dados = (const BYTE *) src;
+    BYTE pequeno[8];
+    Escritor out;
+    if (capacidade >= 8)
+        abrir_escritor_fixo(&out, (BYTE *) dst, capacidade);
+    else
+        abrir_escritor_fixo(&out, pequeno, sizeof(pequeno));
+    if (!descompactar_bloco(ctx, dados + TAMANHO_PREFIXO_ESTENDIDO, n - TAMANHO_PREFIXO_ESTENDIDO, &out) ||
+        out.erro || out.pos != original)
+        return HUFF_ERRO_DADOS;
+    if (out.dados == pequeno)
+        memcpy(dst, pequeno, original);
 
-        if (heap->dados[i]->frequencia <= heap->dados[menor]->frequencia)
-            break;
+    CabecalhoEstendido cabecalho;
+    interpretar_cabecalho_estendido(dados + 4, &cabecalho);
+    if ((cabecalho.flags & ESTENDIDO_CRC32C) && atualizar_crc32c(0, (const BYTE *) dst, original) != cabecalho.crc)
+        return HUFF_ERRO_DADOS;
+    return HUFF_OK;
+}
 
-        trocar(&heap->dados[i], &heap->dados[menor]);
-        i = menor;
-    }
+// Benchmark: mede a vazão de cada etapa e grava em dados_benchmark.txt
 
-    return minimo;
+double cronometro()
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void registrar_medicao(FILE *csv, const char *etapa, uint64_t bytes, double segundos)
+{
+    double mb_por_s = segundos > 0 ? bytes / (1024.0 * 1024.0) / segundos : 0;
+    printf("%-32s %12llu bytes %10.4f s %10.2f MB/s\n", etapa, (unsigned long long) bytes, segundos, mb_por_s);
+    fprintf(csv, "%s,%llu,%f,%f\n", etapa, (unsigned long long) bytes, segundos, mb_por_s);
 }
 
-void contar_frequencias(FILE *arquivo, int *frequencias)
+// Referência: um fread por byte, como o contador fazia antes dos blocos
+void contar_frequencias_por_byte(FILE *arquivo, uint64_t *frequencias)
 {
     BYTE c;
     while (fread(&c, sizeof(BYTE), 1, arquivo))
@@ -108,294 +4032,324 @@ void contar_frequencias(FILE *arquivo, int *frequencias)
     }
 }
 
-No* construir_arvore(int *frequencias)
+uint64_t tamanho_de_arquivo(const char *arquivo)
 {
-    Heap *heap = criar_heap();
-    for (int i = 0; i < 256; i++)
-    {
-        if (frequencias[i])
-        {
-            inserir_heap(heap, criar_no((BYTE)i, frequencias[i], NULL, NULL));
-        }
-    }
-
-    while (heap->tamanho > 1)
-    {
-        No *esq = remover_min(heap);
-        No *dir = remover_min(heap);
-        inserir_heap(heap, criar_no('*', esq->frequencia + dir->frequencia, esq, dir));
-    }
-
-    return remover_min(heap);
+    struct stat info;
+    return stat(arquivo, &info) == 0 ? (uint64_t) info.st_size : 0;
 }
 
-void gerar_codigos(No *raiz, Codigo *tabela, BYTE *codigo, int nivel)
+// Referência: um único histograma, um byte por vez
+void contar_frequencias_simples(const BYTE *dados, size_t n, uint64_t *frequencias)
 {
-    if (raiz == NULL)
-        return;
-
-    if (eh_folha(raiz))
+    for (size_t i = 0; i < n; i++)
     {
-        tabela[raiz->caractere].bits = nivel;
-        memcpy(tabela[raiz->caractere].codigo, codigo, nivel);
-        return;
+        frequencias[dados[i]]++;
     }
-
-    codigo[nivel] = 0;
-    gerar_codigos(raiz->esquerda, tabela, codigo, nivel + 1);
-
-    codigo[nivel] = 1;
-    gerar_codigos(raiz->direita, tabela, codigo, nivel + 1);
 }
 
-void escrever_arvore(No *raiz, FILE *out, int *tamanho)
+// Micro-benchmark do contador em memória, com os dados do arquivo e com
+// uma sequência de um só byte (o pior caso do histograma único)
+void benchmark_histograma(FILE *csv, FILE *in, uint64_t tamanho)
 {
-    if (raiz == NULL)
+    size_t n = tamanho < ((uint64_t) 256 << 20) ? (size_t) tamanho : ((size_t) 256 << 20);
+    BYTE *dados = (BYTE *) malloc(n ? n : 1);
+    if (!dados)
         return;
+    rewind(in);
+    n = fread(dados, sizeof(BYTE), n, in);
 
-    if (eh_folha(raiz))
+    for (int constante = 0; constante <= 1; constante++)
     {
-        BYTE c = raiz->caractere;
-        if (c == '*' || c == '\\')
-        {
-            BYTE barra = '\\';
-            fwrite(&barra, sizeof(BYTE), 1, out);
-            (*tamanho)++;
-        }
-        fwrite(&c, sizeof(BYTE), 1, out);
-        (*tamanho)++;
-        return;
-    }
+        uint64_t simples[256] = {0}, intercalado[256] = {0};
+        if (constante)
+            memset(dados, 'a', n);
 
-    BYTE estrela = '*';
-    fwrite(&estrela, sizeof(BYTE), 1, out);
-    (*tamanho)++;
-    escrever_arvore(raiz->esquerda, out, tamanho);
-    escrever_arvore(raiz->direita, out, tamanho);
-}
+        double inicio = cronometro();
+        contar_frequencias_simples(dados, n, simples);
+        registrar_medicao(csv, constante ? "histograma_simples_constante" : "histograma_simples",
+                          n, cronometro() - inicio);
 
-void escrever_header(FILE *out, int trash_bits, int tree_size)
-{
-    unsigned short header = (trash_bits << 13) | tree_size;
-    BYTE byte1 = header >> 8;
-    BYTE byte2 = header & 0xFF;
-    fwrite(&byte1, sizeof(BYTE), 1, out);
-    fwrite(&byte2, sizeof(BYTE), 1, out);
-}
+        inicio = cronometro();
+        contar_frequencias_bloco(dados, n, intercalado);
+        registrar_medicao(csv, constante ? "histograma_intercalado_constante" : "histograma_intercalado",
+                          n, cronometro() - inicio);
 
-void ler_header(FILE *in, int *trash_bits, unsigned short *tree_size)
-{
-    BYTE byte1, byte2;
-    fread(&byte1, sizeof(BYTE), 1, in);
-    fread(&byte2, sizeof(BYTE), 1, in);
-    unsigned short header = (byte1 << 8) | byte2;
-    *trash_bits = header >> 13;
-    *tree_size = header & 0x1FFF;
+        if (memcmp(simples, intercalado, sizeof(simples)) != 0)
+            printf("Erro: as contagens dos dois histogramas diferem\n");
+    }
+    free(dados);
 }
 
-No* reconstruir_arvore(FILE *in, int *pos)
+// CRC32C com as tabelas e, havendo SSE4.2, com a instrução crc32
+void benchmark_crc32c(FILE *csv, FILE *in, uint64_t tamanho)
 {
-    BYTE c;
-    fread(&c, sizeof(BYTE), 1, in);
-    (*pos)--;
+    size_t n = tamanho < ((uint64_t) 256 << 20) ? (size_t) tamanho : ((size_t) 256 << 20);
+    BYTE *dados = (BYTE *) malloc(n ? n : 1);
+    if (!dados)
+        return;
+    rewind(in);
+    n = fread(dados, sizeof(BYTE), n, in);
+    pthread_once(&crc32c_pronto, montar_tabela_crc32c);
 
-    if (c == '*')
-    {
-        No *esq = reconstruir_arvore(in, pos);
-        No *dir = reconstruir_arvore(in, pos);
-        return criar_no('*', 0, esq, dir);
-    }
-    else if (c == '\\')
+    double inicio = cronometro();
+    uint32_t fatias = ~crc32c_fatias(~0u, dados, n);
+    registrar_medicao(csv, "crc32c_fatias", n, cronometro() - inicio);
+
+#ifdef CRC32C_HARDWARE
+    if (__builtin_cpu_supports("sse4.2"))
     {
-        fread(&c, sizeof(BYTE), 1, in);
-        (*pos)--;
+        inicio = cronometro();
+        uint32_t hardware = ~crc32c_sse42(~0u, dados, n);
+        registrar_medicao(csv, "crc32c_sse42", n, cronometro() - inicio);
+        if (hardware != fatias)
+            printf("Erro: os dois CRC32C diferem\n");
     }
-
-    return criar_no(c, 0, NULL, NULL);
+#endif
+    free(dados);
 }
 
-void compactar_arquivo(const char *entrada, const char *saida)
+// Latência por mensagem da biblioteca: o arquivo em pedaços de 1 KiB,
+// compactados e descompactados um a um, sem contexto e com um só reaproveitado
+#define TAMANHO_MENSAGEM 1024
+
+void benchmark_mensagens(FILE *csv, FILE *in, uint64_t tamanho)
 {
-    FILE *in = fopen(entrada, "rb");
-    if (!in)
+    size_t n = tamanho < ((uint64_t) 16 << 20) ? (size_t) tamanho : ((size_t) 16 << 20);
+    size_t mensagens = n / TAMANHO_MENSAGEM;
+    size_t limite = huff_compress_bound(TAMANHO_MENSAGEM);
+    BYTE *dados = (BYTE *) malloc(n ? n : 1);
+    BYTE *compactados = (BYTE *) malloc(mensagens * limite + 1);
+    size_t *tamanhos = (size_t *) malloc((mensagens + 1) * sizeof(size_t));
+    huff_ctx *ctx = huff_ctx_create();
+    BYTE saida[TAMANHO_MENSAGEM];
+    if (!dados || !compactados || !tamanhos || !ctx || mensagens == 0)
     {
-        printf("Erro ao abrir arquivo de entrada\n");
+        free(dados);
+        free(compactados);
+        free(tamanhos);
+        huff_ctx_free(ctx);
         return;
     }
-
-    int frequencias[256] = {0};
-    contar_frequencias(in, frequencias);
     rewind(in);
+    n = fread(dados, sizeof(BYTE), mensagens * TAMANHO_MENSAGEM, in);
+    mensagens = n / TAMANHO_MENSAGEM;
+    n = mensagens * TAMANHO_MENSAGEM;
 
-    No *raiz = construir_arvore(frequencias);
-    Codigo tabela[256] = {0};
-    BYTE codigo[256];
-    gerar_codigos(raiz, tabela, codigo, 0);
-
-    FILE *out = fopen(saida, "wb");
-    fseek(out, 2, SEEK_SET);
-
-    int tree_size = 0;
-    escrever_arvore(raiz, out, &tree_size);
-
-    BYTE buffer = 0;
-    int bits_usados = 0;
-    BYTE c;
-    while (fread(&c, sizeof(BYTE), 1, in))
+    for (int com_contexto = 0; com_contexto <= 1; com_contexto++)
     {
-        for (int i = 0; i < tabela[c].bits; i++)
+        huff_ctx *usado = com_contexto ? ctx : NULL;
+        int ok = 1;
+        double inicio = cronometro();
+        for (size_t i = 0; i < mensagens; i++)
         {
-            buffer <<= 1;
-            if (tabela[c].codigo[i])
-                buffer |= 1;
-            bits_usados++;
+            tamanhos[i] = limite;
+            ok &= huff_compress_ctx(usado, dados + i * TAMANHO_MENSAGEM, TAMANHO_MENSAGEM,
+                                    compactados + i * limite, &tamanhos[i]) == HUFF_OK;
+        }
+        double compactacao = cronometro() - inicio;
+        registrar_medicao(csv, com_contexto ? "mensagens_1k_compactacao_contexto" : "mensagens_1k_compactacao",
+                          n, compactacao);
 
-            if (bits_usados == 8)
-            {
-                fwrite(&buffer, sizeof(BYTE), 1, out);
-                bits_usados = 0;
-                buffer = 0;
-            }
+        inicio = cronometro();
+        for (size_t i = 0; i < mensagens; i++)
+        {
+            size_t tamanho_saida = sizeof(saida);
+            ok &= huff_decompress_ctx(usado, compactados + i * limite, tamanhos[i], saida, &tamanho_saida) == HUFF_OK &&
+                  memcmp(saida, dados + i * TAMANHO_MENSAGEM, TAMANHO_MENSAGEM) == 0;
         }
-    }
+        double descompactacao = cronometro() - inicio;
+        registrar_medicao(csv, com_contexto ? "mensagens_1k_descompactacao_contexto" : "mensagens_1k_descompactacao",
+                          n, descompactacao);
 
-    if (bits_usados > 0) {
-        buffer <<= (8 - bits_usados);
-        fwrite(&buffer, sizeof(BYTE), 1, out);
+        printf("Mensagens de 1 KiB %s contexto: %.2f us para compactar, %.2f us para descompactar\n",
+               com_contexto ? "com" : "sem", 1e6 * compactacao / mensagens, 1e6 * descompactacao / mensagens);
+        if (!ok)
+            printf("Erro: uma mensagem não voltou igual à original\n");
     }
 
-    int trash_bits = bits_usados ? 8 - bits_usados : 0;
-    rewind(out);
-    escrever_header(out, trash_bits, tree_size);
-
-    fclose(in);
-    fclose(out);
-    printf("Arquivo compactado com sucesso!\n");
+    huff_ctx_free(ctx);
+    free(tamanhos);
+    free(compactados);
+    free(dados);
 }
 
-void descompactar_arquivo(const char *entrada, const char *saida)
+void benchmark(const char *arquivo)
 {
-    FILE *in = fopen(entrada, "rb");
+    FILE *in = fopen(arquivo, "rb");
     if (!in)
     {
         printf("Erro ao abrir arquivo de entrada\n");
         return;
     }
-
-    int trash_bits;
-    unsigned short tree_size;
-    ler_header(in, &trash_bits, &tree_size);
-
-    int pos = tree_size;
-    No *raiz = reconstruir_arvore(in, &pos);
-
-    FILE *out = fopen(saida, "wb");
-    No *atual = raiz;
-    BYTE c;
-    long total_bytes = ftell(in);
     fseek(in, 0, SEEK_END);
-    long tamanho_total = ftell(in) - total_bytes;
-    fseek(in, total_bytes, SEEK_SET);
+    uint64_t tamanho = ftell(in);
+    rewind(in);
 
-    for (long i = 0; i < tamanho_total; i++)
+    FILE *csv = fopen("dados_benchmark.txt", "w");
+    if (!csv)
     {
-        fread(&c, sizeof(BYTE), 1, in);
-        for (int j = 7; j >= 0; j--)
-        {
-            int bit = (c >> j) & 1;
-            atual = bit ? atual->direita : atual->esquerda;
+        printf("Erro ao criar dados_benchmark.txt\n");
+        fclose(in);
+        return;
+    }
+    fprintf(csv, "etapa,bytes,segundos,mb_por_s\n");
 
-            if (eh_folha(atual))
-            {
-                fwrite(&atual->caractere, sizeof(BYTE), 1, out);
-                atual = raiz;
-            }
+    uint64_t frequencias[256] = {0};
+    double inicio = cronometro();
+    contar_frequencias_por_byte(in, frequencias);
+    registrar_medicao(csv, "contagem_por_byte", tamanho, cronometro() - inicio);
+    rewind(in);
 
-            if (i == tamanho_total - 1 && j == trash_bits)
-                break;
-        }
+    Leitor leitor;
+    int contagem_original = threads_contagem;
+    threads_contagem = 1;
+    if (abrir_leitor(&leitor, in))
+    {
+        memset(frequencias, 0, sizeof(frequencias));
+        inicio = cronometro();
+        contar_frequencias(&leitor, frequencias);
+        registrar_medicao(csv, "contagem_em_blocos", tamanho, cronometro() - inicio);
+        fechar_leitor(&leitor);
     }
+    benchmark_histograma(csv, in, tamanho);
+    benchmark_crc32c(csv, in, tamanho);
+    benchmark_mensagens(csv, in, tamanho);
 
-    fclose(in);
-    fclose(out);
-    printf("Arquivo descompactado com sucesso!\n");
-}
-
-// Função nova: Verificar header
-void verificar_header(const char *arquivo)
-{
-    FILE *in = fopen(arquivo, "rb");
-    if (!in)
+    // Contagem paralela de 2 até threads_contagem threads, conferida com a serial
+    for (int t = 2; contagem_original > 1; t = t * 2 < contagem_original ? t * 2 : contagem_original)
     {
-        perror("Erro ao abrir arquivo");
-        return;
+        Mapeamento mapa;
+        uint64_t paralelas[256] = {0};
+        char etapa[64];
+        threads_contagem = t;
+        rewind(in);
+        if (!abrir_entrada(&leitor, in, &mapa))
+            break;
+        snprintf(etapa, sizeof(etapa), "contagem_paralela_%dt", t);
+        inicio = cronometro();
+        contar_frequencias(&leitor, paralelas);
+        registrar_medicao(csv, etapa, tamanho, cronometro() - inicio);
+        fechar_entrada(&leitor, &mapa);
+        if (memcmp(paralelas, frequencias, sizeof(paralelas)) != 0)
+            printf("Erro: a contagem paralela difere da serial\n");
+        if (t == contagem_original)
+            break;
     }
+    threads_contagem = contagem_original;
+    fclose(in);
 
-    int trash_bits;
-    unsigned short tree_size;
-    ler_header(in, &trash_bits, &tree_size);
+    char compactado[300], descompactado[300];
+    snprintf(compactado, sizeof(compactado), "%s.bench.huff", arquivo);
+    snprintf(descompactado, sizeof(descompactado), "%s.bench.dehuff", arquivo);
 
-    printf("Header do arquivo %s:\n", arquivo);
-    printf("- Bits de lixo: %d\n", trash_bits);
-    printf("- Tamanho da árvore: %hu bytes\n", tree_size);
+    // Cada linha mede o modo do seu nome, mesmo com -t, -B, -o, -a, -i ou -D
+    // na linha de comando: as opções voltam ao normal aqui e são restauradas
+    // no final, e o modo em blocos só entra nas linhas compactacao_blocos_*
+    size_t bloco_original = tamanho_bloco_conteiner;
+    int contexto_original = usar_contexto;
+    int adaptativo_original = usar_adaptativo;
+    int intercalado_original = usar_intercalado;
+    Dicionario *dicionario_original = dicionario;
+    tamanho_bloco_conteiner = 0;
+    usar_contexto = usar_adaptativo = usar_intercalado = 0;
+    dicionario = NULL;
 
-    fclose(in);
-}
+    inicio = cronometro();
+    compactar_arquivo(arquivo, compactado);
+    registrar_medicao(csv, "compactacao", tamanho, cronometro() - inicio);
 
-// Função nova: Verificar integridade
-void verificar_integridade(const char *arquivo_compactado, const char *arquivo_descompactado)
-{
-    FILE *f1 = fopen(arquivo_compactado, "rb");
-    FILE *f2 = fopen(arquivo_descompactado, "rb");
+    inicio = cronometro();
+    descompactar_arquivo(compactado, descompactado);
+    registrar_medicao(csv, "descompactacao", tamanho, cronometro() - inicio);
 
-    if (!f1 || !f2)
-    {
-        printf("Erro ao abrir arquivos para verificação\n");
-        if (f1) fclose(f1);
-        if (f2) fclose(f2);
-        return;
-    }
+    // Ordem 0 contra ordem 1: velocidade e tamanho compactado
+    uint64_t tamanho_ordem0 = tamanho_de_arquivo(compactado);
+    usar_contexto = 1;
+    inicio = cronometro();
+    compactar_arquivo(arquivo, compactado);
+    registrar_medicao(csv, "compactacao_ordem1", tamanho, cronometro() - inicio);
+    uint64_t tamanho_ordem1 = tamanho_de_arquivo(compactado);
 
-    int trash_bits;
-    unsigned short tree_size;
-    ler_header(f1, &trash_bits, &tree_size);
-    fseek(f1, 2 + tree_size, SEEK_SET);
+    inicio = cronometro();
+    descompactar_arquivo(compactado, descompactado);
+    registrar_medicao(csv, "descompactacao_ordem1", tamanho, cronometro() - inicio);
+    usar_contexto = 0;
+    printf("Tamanho compactado: ordem 0 %llu bytes (%.2f%%), ordem 1 %llu bytes (%.2f%%)\n",
+           (unsigned long long) tamanho_ordem0, tamanho ? 100.0 * tamanho_ordem0 / tamanho : 0.0,
+           (unsigned long long) tamanho_ordem1, tamanho ? 100.0 * tamanho_ordem1 / tamanho : 0.0);
+    fprintf(csv, "tamanho_ordem0,%llu,0,0\ntamanho_ordem1,%llu,0,0\n",
+            (unsigned long long) tamanho_ordem0, (unsigned long long) tamanho_ordem1);
 
-    int erro = 0;
-    long offset = 0;
-    int c1, c2;
+    // Adaptativo, em uma passada, contra o estático de duas passadas
+    usar_adaptativo = 1;
+    inicio = cronometro();
+    compactar_arquivo(arquivo, compactado);
+    registrar_medicao(csv, "compactacao_adaptativa", tamanho, cronometro() - inicio);
+    uint64_t tamanho_adaptativo = tamanho_de_arquivo(compactado);
 
-    while ((c1 = fgetc(f1)) != EOF && (c2 = fgetc(f2)) != EOF)
-    {
-        if (c1 != c2)
-        {
-            erro = 1;
-            break;
-        }
-        offset++;
-    }
+    inicio = cronometro();
+    descompactar_arquivo(compactado, descompactado);
+    registrar_medicao(csv, "descompactacao_adaptativa", tamanho, cronometro() - inicio);
+    usar_adaptativo = 0;
+    printf("Tamanho compactado: adaptativo %llu bytes (%.2f%%)\n", (unsigned long long) tamanho_adaptativo,
+           tamanho ? 100.0 * tamanho_adaptativo / tamanho : 0.0);
+    fprintf(csv, "tamanho_adaptativo,%llu,0,0\n", (unsigned long long) tamanho_adaptativo);
 
-    if ((c1 != EOF || c2 != EOF) && !erro)
-        erro = 1;
+    // Quatro fluxos intercalados, que só existem no contêiner: a linha a
+    // comparar é descompactacao_blocos_1t, com um fluxo por bloco
+    int threads_original = num_threads;
+    num_threads = 1;
+    usar_intercalado = 1;
+    tamanho_bloco_conteiner = bloco_original ? bloco_original : TAMANHO_BLOCO_CONTEINER;
+    compactar_arquivo(arquivo, compactado);
+    inicio = cronometro();
+    descompactar_arquivo(compactado, descompactado);
+    registrar_medicao(csv, "descompactacao_intercalada", tamanho, cronometro() - inicio);
+    tamanho_bloco_conteiner = 0;
+    usar_intercalado = 0;
+    num_threads = threads_original;
 
-    if (erro)
-    {
-        printf("Arquivos são diferentes a partir do byte %ld\n", offset);
-    }
-    else 
+    int mmap_original = usar_mmap;
+    usar_mmap = 0;
+    inicio = cronometro();
+    compactar_arquivo(arquivo, compactado);
+    registrar_medicao(csv, "compactacao_sem_mmap", tamanho, cronometro() - inicio);
+    usar_mmap = mmap_original;
+
+    // Escalabilidade do modo em blocos, de 1 até num_threads threads
+    tamanho_bloco_conteiner = bloco_original ? bloco_original : TAMANHO_BLOCO_CONTEINER;
+    for (int t = 1; ; t = t * 2 < threads_original ? t * 2 : threads_original)
     {
-        printf("Arquivos são idênticos após a descompactação!\n");
+        char etapa[64];
+        num_threads = t;
+        snprintf(etapa, sizeof(etapa), "compactacao_blocos_%dt", t);
+        inicio = cronometro();
+        compactar_arquivo(arquivo, compactado);
+        registrar_medicao(csv, etapa, tamanho, cronometro() - inicio);
+
+        snprintf(etapa, sizeof(etapa), "descompactacao_blocos_%dt", t);
+        inicio = cronometro();
+        descompactar_arquivo(compactado, descompactado);
+        registrar_medicao(csv, etapa, tamanho, cronometro() - inicio);
+        if (t == threads_original)
+            break;
     }
+    tamanho_bloco_conteiner = bloco_original;
+    num_threads = threads_original;
+    usar_contexto = contexto_original;
+    usar_adaptativo = adaptativo_original;
+    usar_intercalado = intercalado_original;
+    dicionario = dicionario_original;
 
-    fclose(f1);
-    fclose(f2);
+    remove(compactado);
+    remove(descompactado);
+    fclose(csv);
 }
 
-// MAIN
-int main()
+#ifndef HUFF_BIBLIOTECA
+// Menu interativo, quando nenhum modo foi pedido na linha de comando
+int menu(void)
 {
-    setlocale(LC_ALL, "Portuguese");
-
     int opcao;
     char nome_arquivo[256] = {0};
     char nome_saida[256] = {0};
@@ -405,6 +4359,8 @@ int main()
     printf("1. Compactar arquivo\n");
     printf("2. Descompactar arquivo\n");
     printf("3. Verificar header\n");
+    printf("4. Benchmark\n");
+    printf("5. Extrair trecho\n");
     printf("Escolha: ");
     if (scanf("%d", &opcao) != 1)
     {
@@ -439,13 +4395,13 @@ int main()
         nome_saida[strlen(nome_arquivo) - 5] = '\0';
         strcat(nome_saida, ".dehuff");
 
-        descompactar_arquivo(nome_arquivo, nome_saida);
+        int resultado = descompactar_arquivo(nome_arquivo, nome_saida);
 
         printf("\nDeseja verificar a integridade? (s/n): ");
         char resposta = getchar();
         if (resposta == 's' || resposta == 'S')
         {
-            verificar_integridade(nome_arquivo, nome_saida);
+            verificar_integridade(resultado);
         }
 
     }
@@ -456,6 +4412,29 @@ int main()
         nome_arquivo[strcspn(nome_arquivo, "\n")] = '\0';
         verificar_header(nome_arquivo);
     }
+    else if (opcao == 4)
+    {
+        printf("Arquivo para o benchmark: ");
+        fgets(nome_arquivo, sizeof(nome_arquivo), stdin);
+        nome_arquivo[strcspn(nome_arquivo, "\n")] = '\0';
+        benchmark(nome_arquivo);
+    }
+    else if (opcao == 5)
+    {
+        unsigned long long inicio, tamanho;
+        printf("Arquivo .huff de onde extrair: ");
+        fgets(nome_arquivo, sizeof(nome_arquivo), stdin);
+        nome_arquivo[strcspn(nome_arquivo, "\n")] = '\0';
+        printf("Byte inicial e quantidade de bytes: ");
+        if (scanf("%llu %llu", &inicio, &tamanho) != 2)
+        {
+            printf("Entrada inválida\n");
+            return 1;
+        }
+
+        snprintf(nome_saida, sizeof(nome_saida), "%s.trecho", nome_arquivo);
+        extrair_trecho(nome_arquivo, nome_saida, inicio, tamanho);
+    }
     else
     {
         printf("Opção inválida!\n");
@@ -464,3 +4443,201 @@ int main()
 
     return 0;
 }
+
+// MAIN
+int main(int argc, char *argv[])
+{
+    setlocale(LC_ALL, "Portuguese");
+
+    char modo_fluxo = 0;
+    unsigned long long inicio_trecho = 0, tamanho_trecho = 0;
+    const char *arquivo_dicionario = NULL;
+    int primeiro_arquivo = argc;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "-d") == 0 || strcmp(argv[i], "-g") == 0)
+        {
+            modo_fluxo = argv[i][1];
+        }
+        else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc &&
+                 sscanf(argv[i + 1], "%llu:%llu", &inicio_trecho, &tamanho_trecho) == 2)
+        {
+            modo_fluxo = 'x';
+            i++;
+        }
+        else if (modo_fluxo && argv[i][0] != '-')
+        {
+            // O restante são os arquivos do modo em lote
+            primeiro_arquivo = i;
+            break;
+        }
+        else if (strcmp(argv[i], "-D") == 0 && i + 1 < argc)
+        {
+            arquivo_dicionario = argv[++i];
+        }
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+        {
+            long valor = atol(argv[++i]);
+            if (valor > 0)
+                tamanho_bloco_io = valor < TAMANHO_MINIMO_BLOCO_IO ? TAMANHO_MINIMO_BLOCO_IO : (size_t) valor;
+        }
+        else if (strcmp(argv[i], "-B") == 0 && i + 1 < argc)
+        {
+            long valor = atol(argv[++i]);
+            if (valor > 0 && valor <= (1L << 30))
+                tamanho_bloco_conteiner = (size_t) valor;
+        }
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+        {
+            int valor = atoi(argv[++i]);
+            if (valor > 0)
+                num_threads = valor;
+            if (!tamanho_bloco_conteiner)
+                tamanho_bloco_conteiner = TAMANHO_BLOCO_CONTEINER;
+        }
+        else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc)
+        {
+            int valor = atoi(argv[++i]);
+            if (valor > 0)
+                threads_contagem = valor;
+        }
+        else if (strcmp(argv[i], "-M") == 0)
+        {
+            usar_mmap = 0;
+        }
+        else if (strcmp(argv[i], "-o") == 0)
+        {
+            usar_contexto = 1;
+        }
+        else if (strcmp(argv[i], "-a") == 0)
+        {
+            usar_adaptativo = 1;
+        }
+        else if (strcmp(argv[i], "-r") == 0)
+        {
+            usar_rle = 1;
+        }
+        else if (strcmp(argv[i], "-i") == 0)
+        {
+            usar_intercalado = 1;
+            if (!tamanho_bloco_conteiner)
+                tamanho_bloco_conteiner = TAMANHO_BLOCO_CONTEINER;
+        }
+        else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+        {
+            int valor = atoi(argv[++i]);
+            if (valor > 0 && valor <= TAMANHO_MAXIMO_CODIGO)
+                max_bits_codigo = valor;
+        }
+        else
+        {
+            printf("Uso: %s [-b bytes_por_bloco_io] [-l max_bits_codigo]\n"
+                   "       [-B bytes_por_bloco_compactado] [-t threads] [-M (sem mmap)]\n"
+                   "       [-T threads_da_contagem] [-o (ordem 1)] [-a (adaptativo)]\n"
+                   "       [-r (pré-passada RLE)] [-i (4 fluxos)] [-D dicionario]\n"
+                   "       [-c | -d | -g | -x inicio:tamanho] [arquivos...]\n"
+                   "  -c  compacta a entrada padrão para a saída padrão, ou cada arquivo\n"
+                   "      listado para <arquivo>.huff\n"
+                   "  -d  descompacta a entrada padrão para a saída padrão, ou cada\n"
+                   "      <arquivo>.huff listado para <arquivo>.dehuff\n"
+                   "  -g  treina o dicionário de -D com os arquivos listados\n"
+                   "  -x  escreve na saída padrão os bytes [inicio, inicio + tamanho) do\n"
+                   "      contêiner em blocos listado, descompactando só os blocos necessários\n"
+                   "  -D  com -c, -d e no menu, usa o dicionário para arquivos pequenos\n"
+                   "  -o  compacta com uma tabela de códigos por byte anterior\n"
+                   "  -a  compacta com Huffman adaptativo, em uma passada e sem cabeçalho\n"
+                   "  -r  passa os dados por RLE antes do Huffman quando isso os reduz\n"
+                   "  -i  divide cada bloco em 4 fluxos de bits, decodificados juntos\n"
+                   "      (sem -B, usa o contêiner com blocos de 4 MiB)\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (modo_fluxo == 'g')
+    {
+        if (!arquivo_dicionario || primeiro_arquivo == argc ||
+            !treinar_dicionario(arquivo_dicionario, argv + primeiro_arquivo, argc - primeiro_arquivo))
+        {
+            fprintf(stderr, "Erro ao treinar o dicionário (use -D dicionario -g amostras...)\n");
+            return 1;
+        }
+        printf("Dicionário gravado em %s\n", arquivo_dicionario);
+        return 0;
+    }
+
+    // Trecho: como a opção 5 do menu, mas para a saída padrão
+    if (modo_fluxo == 'x')
+    {
+        Escritor escritor;
+        if (primeiro_arquivo != argc - 1 || !abrir_escritor(&escritor, stdout))
+        {
+            fprintf(stderr, "Uso: %s -x inicio:tamanho arquivo.huff\n", argv[0]);
+            return 1;
+        }
+        int64_t escritos = descompactar_intervalo(argv[primeiro_arquivo], inicio_trecho, tamanho_trecho, &escritor);
+        fechar_escritor(&escritor);
+        fflush(stdout);
+        if (escritos < 0 || escritor.erro)
+        {
+            fprintf(stderr, "Erro: o trecho só pode ser extraído de arquivos compactados em blocos (-B) e íntegros\n");
+            return 1;
+        }
+        return 0;
+    }
+
+    Dicionario carregado;
+    if (arquivo_dicionario)
+    {
+        if (!carregar_dicionario(arquivo_dicionario, &carregado))
+        {
+            fprintf(stderr, "Erro ao carregar o dicionário %s\n", arquivo_dicionario);
+            return 1;
+        }
+        dicionario = &carregado;
+    }
+
+    // Lote: cada arquivo listado é tratado como nas opções 1 e 2 do menu
+    if (primeiro_arquivo < argc)
+    {
+        char nome[4096];
+        for (int i = primeiro_arquivo; i < argc; i++)
+        {
+            size_t n = strlen(argv[i]);
+            if (modo_fluxo == 'c')
+            {
+                snprintf(nome, sizeof(nome), "%s.huff", argv[i]);
+                compactar_arquivo(argv[i], nome);
+            }
+            else if (n > 5 && strcmp(argv[i] + n - 5, ".huff") == 0)
+            {
+                snprintf(nome, sizeof(nome), "%.*s.dehuff", (int) (n - 5), argv[i]);
+                descompactar_arquivo(argv[i], nome);
+            }
+            else
+                printf("Ignorado (não é .huff): %s\n", argv[i]);
+        }
+        if (dicionario)
+            liberar_tabela_decodificacao(&dicionario->td);
+        return 0;
+    }
+
+    // Em fluxo a saída padrão é o arquivo, então as mensagens vão para stderr
+    int status = 0;
+    if (modo_fluxo == 'c' && !(usar_adaptativo ? compactar_adaptativo(stdin, stdout) : compactar_fluxo(stdin, stdout)))
+    {
+        fprintf(stderr, "Erro ao compactar a entrada padrão\n");
+        status = 1;
+    }
+    else if (modo_fluxo == 'd' && !descompactar_fluxo(stdin, stdout))
+    {
+        fprintf(stderr, "Erro ao descompactar a entrada padrão (dados corrompidos, ou formato que não é em blocos nem adaptativo)\n");
+        status = 1;
+    }
+    else if (!modo_fluxo)
+        status = menu();
+
+    if (dicionario)
+        liberar_tabela_decodificacao(&dicionario->td);
+    return status;
+}
+#endif
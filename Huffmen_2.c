@@ -19,11 +19,6 @@ typedef struct NoHuffman {
     struct NoHuffman *esquerda, *direita;
 } NoHuffman;
 
-typedef struct NoLista {
-    void *dados;
-    struct NoLista *prox;
-} NoLista;
-
 char* tabela_codigos[TAM_ASCII];
 
 // ================= FUNÇÕES AUXILIARES =================
@@ -32,10 +27,25 @@ void inicializar_tabela_com_zeros(unsigned int tabela[]) {
     memset(tabela, 0, TAM_ASCII * sizeof(unsigned int));
 }
 
+// Lê em blocos e conta em 4 histogramas intercalados, somados no final
 void preencher_tabela_de_frequencia_arquivo(FILE* arquivo, unsigned int tabela[]) {
-    unsigned char byte; // antes, char
-    while (fread(&byte, 1, 1, arquivo) == 1) {
-        tabela[byte]++;
+    static unsigned char buffer[1 << 16]; // antes, um fread por byte
+    unsigned int parciais[4][256] = {{0}};
+    size_t lidos;
+    while ((lidos = fread(buffer, 1, sizeof(buffer), arquivo)) > 0) {
+        size_t i = 0;
+        for (; i + 4 <= lidos; i += 4) {
+            parciais[0][buffer[i]]++;
+            parciais[1][buffer[i + 1]]++;
+            parciais[2][buffer[i + 2]]++;
+            parciais[3][buffer[i + 3]]++;
+        }
+        for (; i < lidos; i++) {
+            parciais[0][buffer[i]]++;
+        }
+    }
+    for (int c = 0; c < 256; c++) {
+        tabela[c] += parciais[0][c] + parciais[1][c] + parciais[2][c] + parciais[3][c];
     }
     rewind(arquivo);
 }
@@ -57,86 +67,57 @@ void liberar_arvore(NoHuffman* raiz) {
     free(raiz);
 }
 
-int comparar_frequencia(void* a, void* b) {
-    NoHuffman* n1 = (NoHuffman*)a;
-    NoHuffman* n2 = (NoHuffman*)b;
-    return (int)n1->frequencia - (int)n2->frequencia;
+// Para o qsort das folhas: ordem crescente de frequência
+int comparar_frequencia(const void* a, const void* b) {
+    const NoHuffman* n1 = *(NoHuffman* const*)a;
+    const NoHuffman* n2 = *(NoHuffman* const*)b;
+    return (n1->frequencia > n2->frequencia) - (n1->frequencia < n2->frequencia);
 }
 
-NoLista* criar_lista(unsigned int freq[]) {
-    NoLista* lista = NULL;
-    for ( unsigned int i = 0; i < TAM_ASCII; i++) {
-        if (freq[i] > 0) {
-            NoHuffman* novo = criar_no( (unsigned char)i , freq[i] );
-            if (!novo) continue;
-            
-            NoLista* novo_no = (NoLista*)malloc(sizeof(NoLista));
-            if (!novo_no) {
-                free(novo);
-                continue;
-            }
-            
-            novo_no->dados = novo;
-            novo_no->prox = lista;
-            lista = novo_no;
-        }
+// Retira o menor nó entre a frente das folhas e a dos nós internos; no
+// empate fica a folha, o que mantém a árvore mais rasa
+NoHuffman* retirar_menor(NoHuffman* folhas[], int* i, int n, NoHuffman* internos[], int* j, int m) {
+    if (*j == m || (*i < n && folhas[*i]->frequencia <= internos[*j]->frequencia)) {
+        return folhas[(*i)++];
     }
-    return lista;
+    return internos[(*j)++];
 }
 
-NoLista* inserir_ordenado(NoLista* lista, void* dados, int (*comparar)(void*, void*)) {
-    if (!dados) return lista;
-    
-    NoLista* novo = (NoLista*)malloc(sizeof(NoLista));
-    if (!novo) return lista;
-    
-    novo->dados = dados;
-    novo->prox = NULL;
+// Construção em tempo linear com duas filas: as folhas ordenadas uma vez
+// e os nós internos, que já nascem em ordem crescente de frequência
+NoHuffman* construir_arvore(unsigned int freq[]) {
+    NoHuffman* folhas[TAM_ASCII];
+    NoHuffman* internos[TAM_ASCII];
+    int n = 0, m = 0, i = 0, j = 0;
 
-    if (!lista || comparar(dados, lista->dados) < 0) {
-        novo->prox = lista;
-        return novo;
-    }
-
-    NoLista* atual = lista;
-    while (atual->prox && comparar(dados, atual->prox->dados) >= 0) {
-        atual = atual->prox;
+    for (unsigned int c = 0; c < TAM_ASCII; c++) {
+        if (freq[c] > 0) {
+            NoHuffman* novo = criar_no((unsigned char)c, freq[c]);
+            if (!novo) continue;
+            folhas[n++] = novo;
+        }
     }
+    if (n == 0) return NULL;
+    qsort(folhas, n, sizeof(NoHuffman*), comparar_frequencia);
 
-    novo->prox = atual->prox;
-    atual->prox = novo;
-    return lista;
-}
-
-NoLista* remover_inicio(NoLista* lista) {
-    if (!lista) return NULL;
-    NoLista* temp = lista;
-    lista = lista->prox;
-    free(temp);
-    return lista;
-}
+    while ((n - i) + (m - j) > 1) {
+        NoHuffman* esquerda = retirar_menor(folhas, &i, n, internos, &j, m);
+        NoHuffman* direita = retirar_menor(folhas, &i, n, internos, &j, m);
 
-NoHuffman* construir_arvore(NoLista* lista) {
-    while (lista && lista->prox) {
-        NoHuffman* esquerda = (NoHuffman*)lista->dados;
-        lista = remover_inicio(lista);
-        
-        NoHuffman* direita = (NoHuffman*)lista->dados;
-        lista = remover_inicio(lista);
-        
         NoHuffman* pai = criar_no(0, esquerda->frequencia + direita->frequencia);
         if (!pai) {
             liberar_arvore(esquerda);
             liberar_arvore(direita);
-            continue;
+            while (i < n) liberar_arvore(folhas[i++]);
+            while (j < m) liberar_arvore(internos[j++]);
+            return NULL;
         }
-        
+
         pai->esquerda = esquerda;
         pai->direita = direita;
-        
-        lista = inserir_ordenado(lista, pai, comparar_frequencia);
+        internos[m++] = pai;
     }
-    return lista ? (NoHuffman*)lista->dados : NULL;
+    return i < n ? folhas[i] : internos[j];
 }
 
 // ================= SERIALIZAÇÃO DA ÁRVORE =================
@@ -258,8 +239,7 @@ void compactar_arquivo(const char *input_filename, const char *output_filename)
     preencher_tabela_de_frequencia_arquivo(in, freq);
 
     // Constrói árvore de Huffman
-    NoLista* lista = criar_lista(freq);
-    NoHuffman* raiz = construir_arvore(lista);
+    NoHuffman* raiz = construir_arvore(freq);
     if (!raiz) {
         fclose(in);
         printf("Erro ao construir árvore de Huffman\n");
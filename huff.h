@@ -0,0 +1,74 @@
+#ifndef HUFF_H
+#define HUFF_H
+
+// Compactação de Huffman de buffers em memória, sem arquivos nem FILE*.
+// A implementação está em Algoritmo_de_Huffman_Concertado.c; para usá-la
+// como biblioteca, compile esse arquivo com -DHUFF_BIBLIOTECA (sem o main):
+//
+//   gcc -O2 -pthread -fvisibility=hidden -DHUFF_BIBLIOTECA -c Algoritmo_de_Huffman_Concertado.c -o huff.o
+//   objcopy --localize-hidden huff.o
+//   ar rcs libhuff.a huff.o
+//
+// Com -fvisibility=hidden e o objcopy, só as funções huff_* (marcadas com
+// HUFF_API) ficam visíveis; as internas não colidem com as do programa
+// que usa a biblioteca. As opções do programa (-r, -i, -l...) ficam nos
+// valores padrão.
+//
+// O resultado tem o mesmo formato dos arquivos .huff (versão 6, com o
+// tamanho original e o CRC32C no cabeçalho), então um buffer compactado
+// gravado em disco é descompactado pelo programa normalmente.
+// As funções podem ser chamadas de várias threads ao mesmo tempo; um
+// huff_ctx, não: cada thread deve ter o seu.
+
+#include <stddef.h>
+
+#define HUFF_OK 0
+#define HUFF_ERRO_DADOS (-1)
+#define HUFF_ERRO_DESTINO (-2)
+#define HUFF_ERRO_MEMORIA (-3)
+
+#if defined(__GNUC__)
+#define HUFF_API __attribute__((visibility("default")))
+#else
+#define HUFF_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Memória de trabalho reaproveitável entre chamadas (buffers de RLE e dos
+// fluxos intercalados, tabela de decodificação). Para muitas mensagens
+// pequenas, evita alocar e montar tudo de novo a cada uma
+typedef struct huff_ctx huff_ctx;
+
+// NULL se faltar memória
+HUFF_API huff_ctx *huff_ctx_create(void);
+HUFF_API void huff_ctx_free(huff_ctx *ctx);
+
+// Maior tamanho que huff_compress pode produzir para "n" bytes
+HUFF_API size_t huff_compress_bound(size_t n);
+
+// Compacta "n" bytes de "src" em "dst". Na entrada, *dst_len é a capacidade
+// de "dst"; na saída, o tamanho compactado. Com capacidade de
+// huff_compress_bound(n) bytes, nunca falta espaço
+HUFF_API int huff_compress(const void *src, size_t n, void *dst, size_t *dst_len);
+
+// Lê em *original o tamanho gravado em um buffer compactado, para alocar o
+// destino de huff_decompress; HUFF_ERRO_DADOS se "src" não for um
+HUFF_API int huff_decompressed_size(const void *src, size_t n, size_t *original);
+
+// Descompacta "n" bytes de "src" em "dst", conferindo o CRC32C. Na entrada,
+// *dst_len é a capacidade de "dst"; na saída, o tamanho original (também
+// quando a capacidade não basta e o retorno é HUFF_ERRO_DESTINO)
+HUFF_API int huff_decompress(const void *src, size_t n, void *dst, size_t *dst_len);
+
+// Iguais às anteriores, usando a memória de "ctx" (que pode ser NULL)
+HUFF_API int huff_compress_ctx(huff_ctx *ctx, const void *src, size_t n, void *dst, size_t *dst_len);
+HUFF_API int huff_decompress_ctx(huff_ctx *ctx, const void *src, size_t n, void *dst, size_t *dst_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif